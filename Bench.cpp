@@ -0,0 +1,422 @@
+/*
+ * Times every stage of the cascade pipeline on its own, for a matrix of scenes and cascade counts,
+ * on the GL path (headless, see HeadlessContext.hpp) and the CPU path.
+ *
+ * Usage: radiance-cascades-bench <scene.tga>... [options]
+ *   --cascades N,M,..  gathered level counts to run (default 6)
+ *   --warmup N         untimed runs before the measured ones, reported separately (default 2)
+ *   --runs N           measured runs (default 10)
+ *   --threads N        CPU worker threads, 0 = one per core (default 0)
+ *   --gpu-only         skip the CPU path
+ *   --cpu-only         skip the GL path
+ *   --sphere           sphere trace the distance field on both paths
+ *   --format NAME      GL cascade storage, see GpuCascades::StorageFormat (default rgba16f)
+ *   --direction-major  GL cascades stored direction major, see setDirectionMajorStorage()
+ *   --probe-scale N    GL probes N times as far apart, see setProbeScale() (default 1)
+ *   --json PATH        write the results as JSON, "-" for stdout instead of the table
+ *
+ * Stages: bitmap, pyramid and distanceField (GL only) for the scene setup, gather.cN for every
+ * gathered level, gather.all (GL only, every level in one dispatch), gather.persistent (GL only,
+ * every level pulled from a ray queue by persistent groups), gather.split.cN (GL only, level N
+ * with its rays split into pieces) for the levels that get split, gather.tiled.cN (GL only, level N
+ * with the shared memory bitmap tile) for the tiled levels, merge.cN for every merge step
+ * (layer N into N - 1), merge.fused (GL only, all merge steps in one dispatch), merge.blocks.cN
+ * and merge.fused.blocks (GL only, the same reading and writing direction blocks), fluence (GL
+ * only, the per probe averages the screen write reads), upsample (GL only,
+ * BiCubicInterpolation.comp from level 0) and screenWrite.
+ * Every stage is timed with a steady clock, GL stages with glFinish() before and after. Has to run
+ * from the directory that holds shaders/, like the viewer.
+ */
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "CascadeConstants.hpp"
+#include "CpuCascades.hpp"
+#include "GpuCascades.hpp"
+#include "HeadlessContext.hpp"
+#include "ImageIO.hpp"
+#include "SceneBitmap.hpp"
+
+namespace {
+
+void printUsage() {
+    std::cout << "Usage: radiance-cascades-bench <scene.tga>... [--cascades N,M,..] [--warmup N] "
+                 "[--runs N] [--threads N] [--gpu-only] [--cpu-only] [--sphere] [--format NAME] "
+                 "[--direction-major] [--probe-scale N] [--json PATH]\n";
+}
+
+struct Stage {
+    std::string name;
+    std::vector<double> warmup;   //ms
+    std::vector<double> samples;  //ms
+};
+
+struct Result {
+    std::string scene;
+    std::string path;  //"gpu" or "cpu"
+    int cascadeCount;
+    std::vector<Stage> stages;
+};
+
+//the stages of one run, in order, so every run adds to the same entries
+class Recorder {
+public:
+    explicit Recorder(Result& result) : result_(result) {}
+
+    void beginRun(bool warmup) {
+        warmup_ = warmup;
+        next_ = 0;
+    }
+
+    void add(const std::string& name, double milliseconds) {
+        if (next_ == result_.stages.size()) result_.stages.push_back({name, {}, {}});
+        Stage& stage = result_.stages[next_++];
+        (warmup_ ? stage.warmup : stage.samples).push_back(milliseconds);
+    }
+
+private:
+    Result& result_;
+    size_t next_ = 0;
+    bool warmup_ = false;
+};
+
+double mean(const std::vector<double>& values) {
+    if (values.empty()) return 0.0;
+    double sum = 0.0;
+    for (double v : values) sum += v;
+    return sum / static_cast<double>(values.size());
+}
+
+//nearest rank, so p99 of 10 runs is the slowest one
+double percentile(std::vector<double> values, double p) {
+    if (values.empty()) return 0.0;
+    std::sort(values.begin(), values.end());
+    const double rank = std::ceil(p * static_cast<double>(values.size()));
+    const size_t index = static_cast<size_t>(std::clamp(rank, 1.0, static_cast<double>(values.size())));
+    return values[index - 1];
+}
+
+double median(const std::vector<double>& values) {
+    if (values.empty()) return 0.0;
+    std::vector<double> sorted = values;
+    std::sort(sorted.begin(), sorted.end());
+    const size_t n = sorted.size();
+    return n % 2 == 1 ? sorted[n / 2] : 0.5 * (sorted[n / 2 - 1] + sorted[n / 2]);
+}
+
+//alternatives to the gather.cN and merge.cN steps, not more work on top of them
+bool isAlternative(const std::string& stage) {
+    return stage.rfind("merge.fused", 0) == 0 || stage.rfind("merge.blocks", 0) == 0 ||
+           stage == "gather.all" || stage == "gather.persistent" ||
+           stage.rfind("gather.split", 0) == 0 || stage.rfind("gather.tiled", 0) == 0;
+}
+
+std::string jsonString(const std::string& s) {
+    std::string out = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') out += '\\';
+        out += c;
+    }
+    return out + "\"";
+}
+
+double millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start)
+        .count();
+}
+
+//glFinish() on both sides, so the time covers the stage's GPU work and nothing queued before it.
+//Not GL_TIME_ELAPSED: llvmpipe reports garbage for the first queries and for compute dispatches
+//that run while the query is being set up.
+template <typename F>
+double timeGl(F&& stage) {
+    glFinish();
+    auto start = std::chrono::steady_clock::now();
+    stage();
+    glFinish();
+    return millisecondsSince(start);
+}
+
+Result benchGpu(const std::string& scene, int cascadeCount, bool sphereTrace,
+                GpuCascades::StorageFormat format, bool directionMajor, int probeScale, int warmup,
+                int runs) {
+    Result result{scene, "gpu", cascadeCount, {}};
+    GpuCascades cascades(scene, cascadeCount);
+    cascades.setStorageFormat(format);
+    cascades.setDirectionMajorStorage(directionMajor);
+    cascades.setProbeScale(probeScale);
+    //like the viewer, 6 levels merge from layer 6
+    cascades.settings().highestLayer = std::min(cascades.cascadeCount(), CASCADE_LAYER_COUNT - 1);
+    cascades.settings().sphereTrace = sphereTrace;
+
+    //screen write target, same format as the viewer's screen cache
+    GLuint target, framebuffer;
+    glGenTextures(1, &target);
+    GpuCascades::bindScratchUnit();
+    glBindTexture(GL_TEXTURE_2D, target);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, CASCADE_TEXTURE_SIDE, CASCADE_TEXTURE_SIDE);
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target, 0);
+    glViewport(0, 0, CASCADE_TEXTURE_SIDE, CASCADE_TEXTURE_SIDE);
+
+    Recorder recorder(result);
+    for (int run = 0; run < warmup + runs; run++) {
+        recorder.beginRun(run < warmup);
+        recorder.add("bitmap", timeGl([&] { cascades.generateBitmap(); }));
+        recorder.add("pyramid", timeGl([&] { cascades.occupancyPyramid().build(); }));
+        recorder.add("distanceField", timeGl([&] { cascades.jumpFlood().build(); }));
+        for (int level = 0; level < cascades.cascadeCount(); level++) {
+            recorder.add("gather.c" + std::to_string(level),
+                         timeGl([&] { cascades.gatherLevel(level); }));
+        }
+        recorder.add("gather.all", timeGl([&] { cascades.gatherAll(); }));
+        recorder.add("gather.persistent", timeGl([&] { cascades.gatherPersistent(); }));
+        cascades.settings().bitmapTileLevels = CASCADE_TILED_LEVELS;
+        for (int level = 0; level < std::min(cascades.cascadeCount(), CASCADE_TILED_LEVELS); level++) {
+            recorder.add("gather.tiled.c" + std::to_string(level),
+                         timeGl([&] { cascades.gatherLevel(level); }));
+        }
+        cascades.settings().bitmapTileLevels = 0;
+        cascades.settings().splitRays = true;
+        for (int level = 0; level < cascades.cascadeCount(); level++) {
+            if (cascadeRaySegments(level) > 1) {
+                recorder.add("gather.split.c" + std::to_string(level),
+                             timeGl([&] { cascades.gatherLevel(level); }));
+            }
+        }
+        cascades.settings().splitRays = false;
+        for (int layer = cascades.settings().highestLayer; layer > 0; layer--) {
+            recorder.add("merge.c" + std::to_string(layer),
+                         timeGl([&] { cascades.mergeLayer(layer); }));
+        }
+        //all of the above in one dispatch. merges the merged layers again, same work
+        recorder.add("merge.fused", timeGl([&] { cascades.mergeFused(); }));
+        cascades.settings().directionBlocks = true;
+        for (int layer = cascades.settings().highestLayer; layer > 0; layer--) {
+            recorder.add("merge.blocks.c" + std::to_string(layer),
+                         timeGl([&] { cascades.mergeLayer(layer); }));
+        }
+        recorder.add("merge.fused.blocks", timeGl([&] { cascades.mergeFused(); }));
+        cascades.settings().directionBlocks = false;
+        recorder.add("fluence", timeGl([&] { cascades.buildFluence(); }));
+        recorder.add("upsample", timeGl([&] { cascades.upsample(); }));
+        recorder.add("screenWrite", timeGl([&] { cascades.screenWrite(); }));
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteTextures(1, &target);
+    return result;
+}
+
+Result benchCpu(const std::string& scene, const imageio::Image& image, int cascadeCount,
+                bool sphereTrace, unsigned& threads, int warmup, int runs) {
+    Result result{scene, "cpu", cascadeCount, {}};
+    SceneBitmap bitmap = SceneBitmap::fromImage(image);
+
+    CpuCascades::Settings settings;
+    settings.cascadeCount = cascadeCount;
+    settings.highestLayer = std::min(cascadeCount, CASCADE_LAYER_COUNT - 1);
+    settings.sphereTrace = sphereTrace;
+    settings.threadCount = threads;
+    CpuCascades cascades(bitmap, settings);
+    threads = cascades.threadCount();
+
+    Recorder recorder(result);
+    for (int run = 0; run < warmup + runs; run++) {
+        recorder.beginRun(run < warmup);
+
+        auto start = std::chrono::steady_clock::now();
+        SceneBitmap regenerated = SceneBitmap::fromImage(image);
+        recorder.add("bitmap", millisecondsSince(start));
+
+        for (int level = 0; level < settings.cascadeCount; level++) {
+            start = std::chrono::steady_clock::now();
+            cascades.gatherLevel(level);
+            recorder.add("gather.c" + std::to_string(level), millisecondsSince(start));
+        }
+        for (int layer = settings.highestLayer; layer > 0; layer--) {
+            start = std::chrono::steady_clock::now();
+            cascades.mergeLayer(layer);
+            recorder.add("merge.c" + std::to_string(layer), millisecondsSince(start));
+        }
+        start = std::chrono::steady_clock::now();
+        cascades.screenWrite();
+        recorder.add("screenWrite", millisecondsSince(start));
+    }
+    return result;
+}
+
+void printTable(const std::vector<Result>& results) {
+    for (const Result& result : results) {
+        std::cout << "\n" << result.scene << ", " << result.cascadeCount << " cascades, "
+                  << result.path << "\n"
+                  << std::left << std::setw(22) << "  stage" << std::right << std::setw(12)
+                  << "warmup" << std::setw(12) << "median" << std::setw(12) << "p95"
+                  << std::setw(12) << "p99" << "   (ms)\n";
+        double total = 0.0;
+        for (const Stage& stage : result.stages) {
+            if (!isAlternative(stage.name)) total += median(stage.samples);
+            std::cout << std::left << std::setw(22) << "  " + stage.name << std::right
+                      << std::fixed << std::setprecision(3) << std::setw(12)
+                      << mean(stage.warmup) << std::setw(12) << median(stage.samples)
+                      << std::setw(12) << percentile(stage.samples, 0.95) << std::setw(12)
+                      << percentile(stage.samples, 0.99) << "\n";
+        }
+        std::cout << std::left << std::setw(22) << "  sum of medians" << std::right
+                  << std::setw(24) << total << "\n";
+        std::cout.unsetf(std::ios_base::floatfield);
+    }
+}
+
+void writeJson(std::ostream& out, const std::vector<Result>& results, const std::string& renderer,
+               unsigned cpuThreads, int warmup, int runs) {
+    out << std::setprecision(6);
+    out << "{\n  \"renderer\": " << jsonString(renderer) << ",\n  \"cpuThreads\": " << cpuThreads
+        << ",\n  \"warmupRuns\": " << warmup << ",\n  \"runs\": " << runs
+        << ",\n  \"unit\": \"ms\",\n  \"results\": [";
+    bool first = true;
+    for (const Result& result : results) {
+        for (const Stage& stage : result.stages) {
+            out << (first ? "\n" : ",\n") << "    {\"scene\": " << jsonString(result.scene)
+                << ", \"path\": " << jsonString(result.path)
+                << ", \"cascades\": " << result.cascadeCount
+                << ", \"stage\": " << jsonString(stage.name)
+                << ", \"warmup\": " << mean(stage.warmup)
+                << ", \"median\": " << median(stage.samples)
+                << ", \"p95\": " << percentile(stage.samples, 0.95)
+                << ", \"p99\": " << percentile(stage.samples, 0.99)
+                << ", \"mean\": " << mean(stage.samples) << ", \"min\": "
+                << (stage.samples.empty() ? 0.0
+                                          : *std::min_element(stage.samples.begin(), stage.samples.end()))
+                << ", \"max\": "
+                << (stage.samples.empty() ? 0.0
+                                          : *std::max_element(stage.samples.begin(), stage.samples.end()))
+                << "}";
+            first = false;
+        }
+    }
+    out << "\n  ]\n}\n";
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> scenes;
+    std::vector<int> cascadeCounts;
+    int warmup = 2;
+    int runs = 10;
+    unsigned threads = 0;
+    bool gpu = true;
+    bool cpu = true;
+    bool sphereTrace = false;
+    GpuCascades::StorageFormat format = GpuCascades::StorageFormat::Rgba16f;
+    bool directionMajor = false;
+    int probeScale = 1;
+    std::string jsonPath;
+    for (int i = 1; i < argc; i++) {
+        const bool hasValue = i + 1 < argc;
+        if (std::strcmp(argv[i], "--cascades") == 0 && hasValue) {
+            std::stringstream list(argv[++i]);
+            std::string count;
+            while (std::getline(list, count, ',')) {
+                cascadeCounts.push_back(std::clamp(std::atoi(count.c_str()), 1, CASCADE_LAYER_COUNT));
+            }
+        } else if (std::strcmp(argv[i], "--warmup") == 0 && hasValue) {
+            warmup = std::max(std::atoi(argv[++i]), 0);
+        } else if (std::strcmp(argv[i], "--runs") == 0 && hasValue) {
+            runs = std::max(std::atoi(argv[++i]), 1);
+        } else if (std::strcmp(argv[i], "--threads") == 0 && hasValue) {
+            threads = static_cast<unsigned>(std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--gpu-only") == 0) {
+            cpu = false;
+        } else if (std::strcmp(argv[i], "--cpu-only") == 0) {
+            gpu = false;
+        } else if (std::strcmp(argv[i], "--sphere") == 0) {
+            sphereTrace = true;
+        } else if (std::strcmp(argv[i], "--format") == 0 && hasValue) {
+            if (!GpuCascades::storageFormatFromName(argv[++i], format)) {
+                std::cerr << "Unknown storage format: " << argv[i] << "\n";
+                printUsage();
+                return 1;
+            }
+        } else if (std::strcmp(argv[i], "--direction-major") == 0) {
+            directionMajor = true;
+        } else if (std::strcmp(argv[i], "--probe-scale") == 0 && hasValue) {
+            probeScale = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--json") == 0 && hasValue) {
+            jsonPath = argv[++i];
+        } else if (argv[i][0] == '-') {
+            std::cerr << "Unknown argument: " << argv[i] << "\n";
+            printUsage();
+            return 1;
+        } else {
+            scenes.push_back(argv[i]);
+        }
+    }
+    if (scenes.empty()) {
+        printUsage();
+        return 1;
+    }
+    if (cascadeCounts.empty()) cascadeCounts.push_back(6);
+
+    //the table goes to stderr when stdout is the JSON
+    std::ostream& log = jsonPath == "-" ? std::cerr : std::cout;
+
+    HeadlessContext context;
+    std::string renderer = "none";
+    if (gpu && context.current()) {
+        renderer = reinterpret_cast<const char*>(glGetString(GL_RENDERER));
+        log << "GL renderer: " << renderer << "\n";
+    } else if (gpu) {
+        std::cerr << "No GL context, only the CPU path runs\n";
+        gpu = false;
+    }
+
+    std::vector<Result> results;
+    unsigned cpuThreads = threads;
+    for (const std::string& scene : scenes) {
+        imageio::Image image = imageio::loadTGA(scene);
+        if (image.empty()) return 1;
+
+        for (int cascadeCount : cascadeCounts) {
+            if (gpu) {
+                log << "gpu: " << scene << ", " << cascadeCount << " cascades\n";
+                results.push_back(benchGpu(scene, cascadeCount, sphereTrace, format,
+                                           directionMajor, probeScale, warmup, runs));
+            }
+            if (cpu) {
+                log << "cpu: " << scene << ", " << cascadeCount << " cascades\n";
+                results.push_back(
+                    benchCpu(scene, image, cascadeCount, sphereTrace, cpuThreads, warmup, runs));
+            }
+        }
+    }
+    if (jsonPath == "-") {
+        writeJson(std::cout, results, renderer, cpuThreads, warmup, runs);
+        return 0;
+    }
+    printTable(results);
+    if (!jsonPath.empty()) {
+        std::ofstream out(jsonPath);
+        if (!out.is_open()) {
+            std::cerr << "Could not open " << jsonPath << " for writing\n";
+            return 1;
+        }
+        writeJson(out, results, renderer, cpuThreads, warmup, runs);
+        std::cout << "\nWrote " << jsonPath << "\n";
+    }
+    return 0;
+}
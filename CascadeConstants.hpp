@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+
+/*
+    Host side copies of the constants that are hard-coded in the cascade shaders.
+    The CPU path has to produce the same cascades as Cascade.comp/MergeCascades.comp/ScreenWrite.frag,
+    so if you change a value in the shaders, change it here as well.
+*/
+
+constexpr int CASCADE_TEXTURE_SIDE = 1024;  // every layer of the cascade array is 1024x1024 texels
+constexpr int CASCADE_LAYER_COUNT = 7;      // layers allocated in the cascade array
+constexpr int CASCADE_SCALING = 4;          // ray count scaling between two levels
+
+constexpr int CASCADE_PROBE_SIDES[CASCADE_LAYER_COUNT] = {2, 4, 8, 16, 32, 64, 128};
+
+constexpr float CASCADE_RAY_LENGTHS[CASCADE_LAYER_COUNT] = {
+    1.41421356f,   // pow(4, 0) * SQRT2
+    5.65685424f,   // pow(4, 1) * SQRT2
+    22.62741699f,  // pow(4, 2) * SQRT2
+    90.50966799f,  // pow(4, 3) * SQRT2
+    362.0386719f,  // pow(4, 4) * SQRT2
+    1448.154688f,  // pow(4, 5) * SQRT2
+    5792.618752f   // pow(4, 6) * SQRT2
+};
+
+constexpr float SQRT2 = 1.41421356f;
+constexpr float PI = 3.14159265359f;
+constexpr float AIR_ABSORPTION = 0.0015f;
+
+//bitmap cell layout, see GenerateSceneBitmap.comp
+constexpr std::uint8_t WALL_MASK = 0x1;
+constexpr std::uint8_t EMITTER_MASK = 0x2;
+constexpr std::uint8_t MATERIAL_MASK = 0xFC;
+
+//max amount of DDA steps a ray of the given level can take, same as MAX_RAY_STEPS in Cascade.comp
+constexpr int cascadeMaxRaySteps(int level) {
+    return static_cast<int>(CASCADE_RAY_LENGTHS[level] * SQRT2) + 1;
+}
+
+//levels below this can march a shared memory copy of the bitmap around their work group,
+//BITMAP_TILE in Cascade.comp
+constexpr int CASCADE_TILED_LEVELS = 3;
+
+//pieces the ray interval of a level is split into by the split gather (CascadeSplitN.comp),
+//~45 cells each. levels that get split at all, 3 and up, get one per 32 rays per probe
+constexpr int cascadeRaySegments(int level) {
+    return level < 3 ? 1 : 1 << (2 * level - 5);
+}
@@ -6,6 +6,8 @@
 #include <string>
 #include <filesystem>
 
+#include "CascadeConstants.hpp"
+
 
 /*
     This was a bit of an experiment to see if i gain any perf from loop unrolling in my cascades.
@@ -16,8 +18,52 @@
 */
 // this should maybe be made more generic but i just need it for loop unrolling in my cascades
 // OpenGL doesn't support multiple different compile-time constant values in the same shader so multiple files are needed
+// CascadeAll.comp and CascadePersistent.comp gather every level in one dispatch instead,
+// CascadeSplitN.comp splits the rays of level N
 namespace CascadePreprocessor {
 
+    //writes the template with the line after the #PreprocessCascadeLevel marker replaced by defineDirective
+    inline void writeCascadeShader(const std::string& templateContent, const std::string& outputFilename,
+                                   const std::string& defineDirective) {
+        std::ofstream outFile(outputFilename);
+        if (!outFile.is_open()) {
+            std::cerr << "ERROR: Couldn't open file: " << outputFilename << "\n";
+            return;
+        }
+
+        //walk the file to find the marker for where to insert directive.
+        std::istringstream stream(templateContent);
+        std::ostringstream modified;
+        std::string line;
+        bool directiveInserted = false;
+
+        while(std::getline(stream, line)) {
+            if(!directiveInserted && line.find("#PreprocessCascadeLevel") != std::string::npos){
+                directiveInserted = true;
+
+                line = defineDirective; //add the define
+                modified << line << "\n";
+
+                std::getline(stream, line); //empty the next line, should contain a dummy #define CASCADE_LEVEL -1
+                line = "\n";
+            }
+            modified << line << "\n";
+
+        }
+        if(!directiveInserted)
+        {
+            std::cout << "ERROR: Failed to find preprocessing directive location!\nMake sure #PreprocessCascadeLevel exists in Cascades.comp!";
+            outFile.close();
+        }
+        else
+        {
+            outFile << modified.str();
+            outFile.close();
+        }
+
+        std::cout << "Preprocessor generated cascade file: " << outputFilename << "\n";
+    }
+
     inline void preprocessCascades(const int cascadeCount) {
 
         std::ifstream templateFile("shaders/Cascade.comp");
@@ -32,49 +78,24 @@ namespace CascadePreprocessor {
         std::filesystem::create_directories("shaders/generated/");
 
         for (int c = 0; c < cascadeCount; ++c) {
-            std::ostringstream outputFilename;
-            outputFilename << "shaders/generated/" << "Cascade" << c << ".comp";
+            const std::string level = std::to_string(c);
+            writeCascadeShader(templateContent, "shaders/generated/Cascade" + level + ".comp",
+                               "#define CASCADE_LEVEL " + level + "\n");
 
-            std::ofstream outFile(outputFilename.str());
-            if (!outFile.is_open()) {
-                std::cerr << "ERROR: Couldn't open file: " << outputFilename.str() << "\n";
-                continue;
+            //the split gather of the levels with long rays, see RAY_SEGMENTS in Cascade.comp
+            if (cascadeRaySegments(c) > 1) {
+                writeCascadeShader(templateContent, "shaders/generated/CascadeSplit" + level + ".comp",
+                                   "#define CASCADE_LEVEL " + level + "\n#define RAY_SEGMENTS " +
+                                   std::to_string(cascadeRaySegments(c)) + "\n");
             }
-            
-            std::string defineDirective = "#define CASCADE_LEVEL " + std::to_string(c) + "\n";
-            
-            //walk the file to find the marker for where to insert directive.
-            std::istringstream stream(templateContent);
-            std::ostringstream modified;
-            std::string line;
-            bool directiveInserted = false;
-
-            while(std::getline(stream, line)) {
-                if(!directiveInserted && line.find("#PreprocessCascadeLevel") != std::string::npos){
-                    directiveInserted = true;
-                    
-                    line = defineDirective; //add the define
-                    modified << line << "\n";
-                    
-                    std::getline(stream, line); //empty the next line, should contain a dummy #define CASCADE_LEVEL -1
-                    line = "\n";
-                }
-                modified << line << "\n";
-
-            }
-            if(!directiveInserted)
-            {
-                std::cout << "ERROR: Failed to find preprocessing directive location!\nMake sure #PreprocessCascadeLevel exists in Cascades.comp!";
-                outFile.close();
-            }
-            else
-            {
-                outFile << modified.str();
-                outFile.close();
-            }
-
-            std::cout << "Preprocessor generated cascade file: " << outputFilename.str() << "\n";
         }
+        //every level in one shader, with a switch on the work group z in main()
+        writeCascadeShader(templateContent, "shaders/generated/CascadeAll.comp",
+                           "#define CASCADE_LEVEL_COUNT " + std::to_string(cascadeCount) + "\n");
+        //every level again, but pulled from a ray queue by a fixed grid of groups
+        writeCascadeShader(templateContent, "shaders/generated/CascadePersistent.comp",
+                           "#define CASCADE_LEVEL_COUNT " + std::to_string(cascadeCount) +
+                           "\n#define PERSISTENT_THREADS\n");
     }
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,106 @@
+/*
+ * Bakes the lighting of a scene on the CPU and writes it to a TGA file. No GPU or window needed.
+ *
+ * Usage: radiance-cascades-cpu-bake <scene.tga> <output.tga> [options]
+ *   --cascades N   amount of gathered levels (default 6)
+ *   --layer N      layer to write to the output image (default 0)
+ *   --rlm N        ray length multiplier (default 1)
+ *   --threads N    worker threads, 0 = one per core (default 0)
+ *   --no-merge     skip the bilinear merge
+ *   --tiled        evaluate the low levels tile by tile, see CpuCascades.hpp
+ *   --packed       march the bit-packed bitmap, skips runs of empty blocks
+ *   --sphere       sphere trace a jump flooded distance field, the gather time includes the flood
+ */
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include "CpuCascades.hpp"
+#include "ImageIO.hpp"
+#include "SceneBitmap.hpp"
+
+namespace {
+
+void printUsage() {
+    std::cout << "Usage: radiance-cascades-cpu-bake <scene.tga> <output.tga> [--cascades N] "
+                 "[--layer N] [--rlm N] [--threads N] [--no-merge] [--tiled] [--packed] "
+                 "[--sphere]\n";
+}
+
+double millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start)
+        .count();
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        printUsage();
+        return 1;
+    }
+    const std::string scenePath = argv[1];
+    const std::string outputPath = argv[2];
+
+    CpuCascades::Settings settings;
+    for (int i = 3; i < argc; i++) {
+        const bool hasValue = i + 1 < argc;
+        if (std::strcmp(argv[i], "--cascades") == 0 && hasValue) {
+            settings.cascadeCount = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--layer") == 0 && hasValue) {
+            settings.screenLayer = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--rlm") == 0 && hasValue) {
+            settings.rayLengthMultiplier = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--threads") == 0 && hasValue) {
+            settings.threadCount = static_cast<unsigned>(std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--no-merge") == 0) {
+            settings.merge = false;
+        } else if (std::strcmp(argv[i], "--tiled") == 0) {
+            settings.tiled = true;
+        } else if (std::strcmp(argv[i], "--packed") == 0) {
+            settings.packedBitmap = true;
+        } else if (std::strcmp(argv[i], "--sphere") == 0) {
+            settings.sphereTrace = true;
+        } else {
+            std::cerr << "Unknown argument: " << argv[i] << "\n";
+            printUsage();
+            return 1;
+        }
+    }
+
+    imageio::Image sceneImage = imageio::loadTGA(scenePath);
+    if (sceneImage.empty()) return 1;
+    SceneBitmap scene = SceneBitmap::fromImage(sceneImage);
+
+    CpuCascades cascades(scene, settings);
+    std::cout << "Baking " << scenePath << " (" << scene.width() << " x " << scene.height()
+              << ") on " << cascades.threadCount() << " threads\n";
+
+    if (settings.tiled) {
+        //the stages are interleaved per tile, so there's only a total
+        auto start = std::chrono::steady_clock::now();
+        cascades.run();
+        std::cout << "tiled run:    " << millisecondsSince(start) << " ms\n";
+    } else {
+        auto start = std::chrono::steady_clock::now();
+        cascades.gather();
+        std::cout << "gather:       " << millisecondsSince(start) << " ms\n";
+
+        start = std::chrono::steady_clock::now();
+        cascades.merge();
+        std::cout << "merge:        " << millisecondsSince(start) << " ms\n";
+
+        start = std::chrono::steady_clock::now();
+        cascades.screenWrite();
+        std::cout << "screen write: " << millisecondsSince(start) << " ms\n";
+    }
+
+    if (!imageio::writeTGA(outputPath, CASCADE_TEXTURE_SIDE, CASCADE_TEXTURE_SIDE,
+                           imageio::toRGB8(cascades.image()))) {
+        return 1;
+    }
+    std::cout << "Wrote " << outputPath << "\n";
+    return 0;
+}
@@ -0,0 +1,442 @@
+#include "CpuCascades.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+constexpr size_t LAYER_TEXELS = static_cast<size_t>(CASCADE_TEXTURE_SIDE) * CASCADE_TEXTURE_SIDE;
+
+//setting up a ray costs about as much as this many DDA steps, keeps level 0 tasks from being tiny
+constexpr float RAY_SETUP_COST = 8.f;
+//gather tasks per thread, more tasks = better balance but more scheduling overhead
+constexpr int TASKS_PER_THREAD = 16;
+
+struct GatherTask {
+    int level;
+    int rowBegin;
+    int rowEnd;
+};
+
+//the 4 possible weights when doing bilinear merging in a grid, [offset.y][offset.x]
+constexpr float MERGE_WEIGHTS[2][2][4] = {
+    {{0.5625f, 0.1875f, 0.1875f, 0.0625f}, {0.1875f, 0.5625f, 0.0625f, 0.1875f}},
+    {{0.1875f, 0.0625f, 0.5625f, 0.1875f}, {0.0625f, 0.1875f, 0.1875f, 0.5625f}},
+};
+
+struct Rgb {
+    float r = 0.f, g = 0.f, b = 0.f;
+};
+
+//a rectangle of texels [x0, x1) x [y0, y1) in cascade layer coordinates
+struct TexelRect {
+    int x0, y0, x1, y1;
+
+    int width() const { return x1 - x0; }
+    int height() const { return y1 - y0; }
+};
+
+constexpr TexelRect FULL_LAYER = {0, 0, CASCADE_TEXTURE_SIDE, CASCADE_TEXTURE_SIDE};
+
+//a whole cascade layer, or the part of one a tile works on. indexed with layer coordinates
+struct LayerView {
+    CascadeTexel* data;
+    TexelRect rect;
+
+    CascadeTexel& at(int x, int y) const {
+        return data[static_cast<size_t>(y - rect.y0) * rect.width() + (x - rect.x0)];
+    }
+};
+
+//texels of every probe with side 'side' that bilinear sampling from inside 'rect' can touch.
+//bilinearBase() picks probes up to one to the left/top or right/bottom of the containing one.
+TexelRect probeHalo(const TexelRect& rect, int side) {
+    auto lo = [side](int v) { return std::max(0, (v / side - 1) * side); };
+    auto hi = [side](int v) { return std::min(CASCADE_TEXTURE_SIDE, ((v - 1) / side + 2) * side); };
+    return {lo(rect.x0), lo(rect.y0), hi(rect.x1), hi(rect.y1)};
+}
+
+//average of the 4 source directions starting at dirBlockIndex, SampleProbe() in MergeCascades.comp
+Rgb sampleMergeProbe(const LayerView& source, int sourceSide, int probeX, int probeY,
+                     int dirBlockIndex) {
+    const int gridExtent = CASCADE_TEXTURE_SIDE / sourceSide;
+    if (probeX < 0 || probeY < 0 || probeX >= gridExtent || probeY >= gridExtent) return {};
+
+    //groups of 4 indicies will always share y value.
+    const int x = probeX * sourceSide + dirBlockIndex % sourceSide;
+    const int y = probeY * sourceSide + dirBlockIndex / sourceSide;
+    const CascadeTexel* texel = &source.at(x, y);
+
+    Rgb radiance;
+    for (int i = 0; i < CASCADE_SCALING; i++) {
+        radiance.r += texel[i].r;
+        radiance.g += texel[i].g;
+        radiance.b += texel[i].b;
+    }
+    radiance.r *= 0.25f;
+    radiance.g *= 0.25f;
+    radiance.b *= 0.25f;
+    return radiance;
+}
+
+//average of all directions of a probe, SampleProbe() in ScreenWrite.frag
+Rgb sampleScreenProbe(const LayerView& layer, int side, int probeX, int probeY) {
+    const int gridExtent = CASCADE_TEXTURE_SIDE / side;
+    if (probeX < 0 || probeY < 0 || probeX >= gridExtent || probeY >= gridExtent) return {};
+
+    Rgb light;
+    for (int y = 0; y < side; y++) {
+        const CascadeTexel* row = &layer.at(probeX * side, probeY * side + y);
+        for (int x = 0; x < side; x++) {
+            light.r += row[x].r;
+            light.g += row[x].g;
+            light.b += row[x].b;
+        }
+    }
+    const float avg = 1.f / static_cast<float>(side * side);
+    light.r *= avg;
+    light.g *= avg;
+    light.b *= avg;
+    return light;
+}
+
+//source probe whose center is up and to the left of coord + which of the 4 weights to use.
+//shifts the probe coords to be the 4 probes which centers are the closest to coord.
+void bilinearBase(float probeCoordX, float probeCoordY, int& baseX, int& baseY, int& offsetX,
+                  int& offsetY) {
+    baseX = static_cast<int>(std::floor(probeCoordX));
+    baseY = static_cast<int>(std::floor(probeCoordY));
+    offsetX = 1 - static_cast<int>(std::floor((probeCoordX - static_cast<float>(baseX)) * 2.f));
+    offsetY = 1 - static_cast<int>(std::floor((probeCoordY - static_cast<float>(baseY)) * 2.f));
+    baseX -= offsetX;
+    baseY -= offsetY;
+}
+
+//texels [x0, x1) of row y of a level, one ray each. sphere traces the distance field if there is
+//one, else marches the packed bitmap if there is one
+void gatherSpan(const SceneBitmap& scene, const PackedSceneBitmap* packedScene,
+                const DistanceField* distanceField, int level, int rayLengthMultiplier, int packet,
+                int y, int x0, int x1, CascadeTexel* out) {
+    if (distanceField) {
+        for (int x = x0; x < x1; x++) {
+            CascadeRay ray = CpuRayMarch::setupRay(level, x, y, scene.width(), scene.height(),
+                                                   rayLengthMultiplier);
+            out[x - x0] = CpuRayMarch::march(scene, *distanceField, ray);
+        }
+        return;
+    }
+
+    if (packedScene) {
+        for (int x = x0; x < x1; x++) {
+            CascadeRay ray = CpuRayMarch::setupRay(level, x, y, scene.width(), scene.height(),
+                                                   rayLengthMultiplier);
+            out[x - x0] = CpuRayMarch::march(*packedScene, ray);
+        }
+        return;
+    }
+
+    if (packet == 1) {
+        for (int x = x0; x < x1; x++) {
+            CascadeRay ray = CpuRayMarch::setupRay(level, x, y, scene.width(), scene.height(),
+                                                   rayLengthMultiplier);
+            out[x - x0] = CpuRayMarch::march(scene, ray);
+        }
+        return;
+    }
+
+    //neighbouring texels in a row are rays of the same level, march them side by side
+    CascadeRay rays[8];
+    for (int x = x0; x < x1; x += packet) {
+        const int count = std::min(packet, x1 - x);
+        for (int i = 0; i < count; i++) {
+            rays[i] = CpuRayMarch::setupRay(level, x + i, y, scene.width(), scene.height(),
+                                            rayLengthMultiplier);
+        }
+        CpuRayMarch::marchPacket(scene, rays, count, out + (x - x0));
+    }
+}
+
+//merges the source level into texel (x, y) of the level below it, main() of MergeCascades.comp
+void mergeTexel(CascadeTexel& texel, const LayerView& source, int targetSide, int sourceSide,
+                bool applyMerge, int x, int y) {
+    if (texel.a > 0.f) return;  //blocked rays don't see anything further away
+
+    if (!applyMerge) {
+        const CascadeTexel& above = source.at(x, y);
+        texel.r += above.r;
+        texel.g += above.g;
+        texel.b += above.b;
+        return;
+    }
+
+    int baseX, baseY, offsetX, offsetY;
+    bilinearBase(static_cast<float>(x) / static_cast<float>(sourceSide),
+                 static_cast<float>(y) / static_cast<float>(sourceSide), baseX, baseY, offsetX,
+                 offsetY);
+    const float* weight = MERGE_WEIGHTS[offsetY][offsetX];
+
+    //the 4 source directions closest to the target direction
+    const int tgtDirIndex = (y % targetSide) * targetSide + (x % targetSide);
+    const int srcIndexBlock = tgtDirIndex * CASCADE_SCALING;
+
+    const Rgb p00 = sampleMergeProbe(source, sourceSide, baseX, baseY, srcIndexBlock);
+    const Rgb p10 = sampleMergeProbe(source, sourceSide, baseX + 1, baseY, srcIndexBlock);
+    const Rgb p01 = sampleMergeProbe(source, sourceSide, baseX, baseY + 1, srcIndexBlock);
+    const Rgb p11 = sampleMergeProbe(source, sourceSide, baseX + 1, baseY + 1, srcIndexBlock);
+
+    texel.r += p00.r * weight[0] + p10.r * weight[1] + p01.r * weight[2] + p11.r * weight[3];
+    texel.g += p00.g * weight[0] + p10.g * weight[1] + p01.g * weight[2] + p11.g * weight[3];
+    texel.b += p00.b * weight[0] + p10.b * weight[1] + p01.b * weight[2] + p11.b * weight[3];
+}
+
+//RGB of pixel (x, y), main() of ScreenWrite.frag
+void screenPixel(float* pixel, const LayerView& source, int side, bool interpolate, int x, int y) {
+    if (!interpolate) {
+        const CascadeTexel& texel = source.at(x, y);
+        pixel[0] = texel.r * 10.f;
+        pixel[1] = texel.g * 10.f;
+        pixel[2] = texel.b * 10.f;
+        return;
+    }
+
+    //pixel centers, like the fragments of the fullscreen quad
+    int baseX, baseY, offsetX, offsetY;
+    bilinearBase((static_cast<float>(x) + 0.5f) / static_cast<float>(side),
+                 (static_cast<float>(y) + 0.5f) / static_cast<float>(side), baseX, baseY, offsetX,
+                 offsetY);
+    const float* weight = MERGE_WEIGHTS[offsetY][offsetX];
+
+    const Rgb p00 = sampleScreenProbe(source, side, baseX, baseY);
+    const Rgb p10 = sampleScreenProbe(source, side, baseX + 1, baseY);
+    const Rgb p01 = sampleScreenProbe(source, side, baseX, baseY + 1);
+    const Rgb p11 = sampleScreenProbe(source, side, baseX + 1, baseY + 1);
+
+    const float r = p00.r * weight[0] + p10.r * weight[1] + p01.r * weight[2] + p11.r * weight[3];
+    const float g = p00.g * weight[0] + p10.g * weight[1] + p01.g * weight[2] + p11.g * weight[3];
+    const float b = p00.b * weight[0] + p10.b * weight[1] + p01.b * weight[2] + p11.b * weight[3];
+
+    //gamma correction
+    pixel[0] = std::pow(r, 1.f / 2.2f);
+    pixel[1] = std::pow(g, 1.f / 2.2f);
+    pixel[2] = std::pow(b, 1.f / 2.2f);
+}
+
+}  // namespace
+
+CpuCascades::CpuCascades(const SceneBitmap& scene) : CpuCascades(scene, Settings()) {}
+
+CpuCascades::CpuCascades(const SceneBitmap& scene, const Settings& settings)
+    : scene_(&scene)
+    , settings_(settings)
+    , scheduler_(settings.threadCount)
+    , cascades_(LAYER_TEXELS * CASCADE_LAYER_COUNT)
+    , image_(LAYER_TEXELS * 3, 0.f) {}
+
+const CascadeTexel* CpuCascades::layer(int index) const {
+    return cascades_.data() + LAYER_TEXELS * static_cast<size_t>(index);
+}
+
+CascadeTexel* CpuCascades::layerData(int index) {
+    return cascades_.data() + LAYER_TEXELS * static_cast<size_t>(index);
+}
+
+void CpuCascades::run() {
+    prepareScene();
+
+    const int tiledLevels = std::clamp(settings_.tiledLevels, 0, CASCADE_LAYER_COUNT);
+    const int screenLayer = std::clamp(settings_.screenLayer, 0, CASCADE_LAYER_COUNT - 1);
+    if (!settings_.tiled || screenLayer >= tiledLevels) {
+        gather();
+        merge();
+        screenWrite();
+        return;
+    }
+
+    //full layers down to the first tiled level, the tiles merge from there
+    const int levels = std::clamp(settings_.cascadeCount, 0, CASCADE_LAYER_COUNT);
+    const int highest = std::clamp(settings_.highestLayer, 0, CASCADE_LAYER_COUNT - 1);
+    gatherLevels(tiledLevels, levels);
+    mergeLayers(highest, tiledLevels + 1);
+
+    const int tileSize = std::clamp(settings_.tileSize, 1, CASCADE_TEXTURE_SIDE);
+    const int tilesPerSide = (CASCADE_TEXTURE_SIDE + tileSize - 1) / tileSize;
+    scheduler_.run(tilesPerSide * tilesPerSide, [&](int tile) {
+        const int x0 = tile % tilesPerSide * tileSize;
+        const int y0 = tile / tilesPerSide * tileSize;
+        evaluateTile(x0, y0, std::min(x0 + tileSize, CASCADE_TEXTURE_SIDE),
+                     std::min(y0 + tileSize, CASCADE_TEXTURE_SIDE));
+    });
+}
+
+void CpuCascades::gather() {
+    prepareScene();
+    gatherLevels(0, std::clamp(settings_.cascadeCount, 0, CASCADE_LAYER_COUNT));
+}
+
+void CpuCascades::gatherLevel(int level) {
+    prepareScene();
+    gatherLevels(level, level + 1);
+}
+
+void CpuCascades::prepareScene() {
+    //built once, before the workers need them
+    if (settings_.packedBitmap && packedScene_.empty()) packedScene_ = PackedSceneBitmap(*scene_);
+    if (settings_.sphereTrace && distanceField_.empty()) {
+        distanceField_ = DistanceField(*scene_, scheduler_);
+    }
+}
+
+const PackedSceneBitmap* CpuCascades::packedScene() const {
+    return settings_.packedBitmap ? &packedScene_ : nullptr;
+}
+
+const DistanceField* CpuCascades::distanceField() const {
+    return settings_.sphereTrace ? &distanceField_ : nullptr;
+}
+
+void CpuCascades::gatherLevels(int first, int last) {
+    if (first >= last) return;
+
+    //rays are 4x longer every level, so a row of level 5 costs ~1000x a row of level 0.
+    //cut every level into bands of rows that cost about the same, and gather all levels at once.
+    //full width bands instead of probe tiles: a band is one contiguous run of the row major layer
+    //and gatherSpan() fills whole rows packet by packet, while every texel of a level costs about
+    //the same, so square tiles wouldn't balance any better.
+    auto rowCost = [](int level) {
+        return CASCADE_TEXTURE_SIDE * (CASCADE_RAY_LENGTHS[level] + RAY_SETUP_COST);
+    };
+
+    float totalCost = 0.f;
+    for (int level = first; level < last; level++) {
+        totalCost += rowCost(level) * static_cast<float>(CASCADE_TEXTURE_SIDE);
+    }
+    const float taskCost = totalCost / static_cast<float>(scheduler_.size() * TASKS_PER_THREAD);
+
+    std::vector<GatherTask> tasks;
+    for (int level = first; level < last; level++) {
+        const int rows = std::clamp(static_cast<int>(std::lround(taskCost / rowCost(level))), 1,
+                                    CASCADE_TEXTURE_SIDE);
+        for (int y = 0; y < CASCADE_TEXTURE_SIDE; y += rows) {
+            tasks.push_back({level, y, std::min(y + rows, CASCADE_TEXTURE_SIDE)});
+        }
+    }
+
+    //heaviest first, the scheduler starts those before the cheap ones
+    std::stable_sort(tasks.begin(), tasks.end(), [&](const GatherTask& a, const GatherTask& b) {
+        return rowCost(a.level) * static_cast<float>(a.rowEnd - a.rowBegin) >
+               rowCost(b.level) * static_cast<float>(b.rowEnd - b.rowBegin);
+    });
+
+    scheduler_.run(static_cast<int>(tasks.size()), [&](int i) {
+        gatherRows(tasks[i].level, tasks[i].rowBegin, tasks[i].rowEnd);
+    });
+}
+
+void CpuCascades::gatherRows(int level, int rowBegin, int rowEnd) {
+    CascadeTexel* target = layerData(level);
+    const int packet = settings_.simd ? CpuRayMarch::packetWidth() : 1;
+
+    for (int y = rowBegin; y < rowEnd; y++) {
+        gatherSpan(*scene_, packedScene(), distanceField(), level, settings_.rayLengthMultiplier,
+                   packet, y, 0, CASCADE_TEXTURE_SIDE,
+                   target + static_cast<size_t>(y) * CASCADE_TEXTURE_SIDE);
+    }
+}
+
+void CpuCascades::merge() {
+    mergeLayers(std::clamp(settings_.highestLayer, 0, CASCADE_LAYER_COUNT - 1), 1);
+}
+
+void CpuCascades::mergeLayers(int highestSource, int lowestSource) {
+    for (int i = highestSource; i >= std::max(1, lowestSource); i--) {
+        mergeLayer(i);
+    }
+}
+
+void CpuCascades::mergeLayer(int sourceLayer) {
+    const int targetSide = CASCADE_PROBE_SIDES[sourceLayer - 1];
+    const int sourceSide = CASCADE_PROBE_SIDES[sourceLayer];
+    const LayerView source{layerData(sourceLayer), FULL_LAYER};
+    CascadeTexel* target = layerData(sourceLayer - 1);
+    const bool applyMerge = settings_.merge;
+
+    scheduler_.parallelFor(0, CASCADE_TEXTURE_SIDE, 4, [&](int y) {
+        CascadeTexel* row = target + static_cast<size_t>(y) * CASCADE_TEXTURE_SIDE;
+        for (int x = 0; x < CASCADE_TEXTURE_SIDE; x++) {
+            mergeTexel(row[x], source, targetSide, sourceSide, applyMerge, x, y);
+        }
+    });
+}
+
+void CpuCascades::screenWrite() {
+    const int layerIndex = std::clamp(settings_.screenLayer, 0, CASCADE_LAYER_COUNT - 1);
+    const int side = CASCADE_PROBE_SIDES[layerIndex];
+    const LayerView source{layerData(layerIndex), FULL_LAYER};
+    const bool interpolate = settings_.interpolate;
+
+    scheduler_.parallelFor(0, CASCADE_TEXTURE_SIDE, 4, [&](int y) {
+        float* row = image_.data() + static_cast<size_t>(y) * CASCADE_TEXTURE_SIDE * 3;
+        for (int x = 0; x < CASCADE_TEXTURE_SIDE; x++) {
+            screenPixel(row + x * 3, source, side, interpolate, x, y);
+        }
+    });
+}
+
+void CpuCascades::evaluateTile(int x0, int y0, int x1, int y1) {
+    const int levels = std::clamp(settings_.cascadeCount, 0, CASCADE_LAYER_COUNT);
+    const int highest = std::clamp(settings_.highestLayer, 0, CASCADE_LAYER_COUNT - 1);
+    const int screenLayer = std::clamp(settings_.screenLayer, 0, CASCADE_LAYER_COUNT - 1);
+    const int tiledLevels = std::clamp(settings_.tiledLevels, 0, CASCADE_LAYER_COUNT);
+    const int packet = settings_.simd ? CpuRayMarch::packetWidth() : 1;
+
+    //what every tiled level needs of the one below it, grows by a probe on each side per level
+    TexelRect rects[CASCADE_LAYER_COUNT];
+    rects[screenLayer] = probeHalo({x0, y0, x1, y1}, CASCADE_PROBE_SIDES[screenLayer]);
+    for (int level = screenLayer + 1; level < tiledLevels; level++) {
+        rects[level] = probeHalo(rects[level - 1], CASCADE_PROBE_SIDES[level]);
+    }
+
+    //reused between tiles, so the working set stays in cache instead of being reallocated
+    thread_local std::vector<CascadeTexel> scratch[CASCADE_LAYER_COUNT];
+
+    LayerView views[CASCADE_LAYER_COUNT];
+    for (int level = tiledLevels - 1; level >= screenLayer; level--) {
+        const TexelRect& rect = rects[level];
+        scratch[level].resize(static_cast<size_t>(rect.width()) * rect.height());
+        const LayerView view{scratch[level].data(), rect};
+        views[level] = view;
+
+        for (int y = rect.y0; y < rect.y1; y++) {
+            CascadeTexel* row = &view.at(rect.x0, y);
+            if (level < levels) {
+                gatherSpan(*scene_, packedScene(), distanceField(), level,
+                           settings_.rayLengthMultiplier, packet, y, rect.x0, rect.x1, row);
+            } else {
+                std::fill(row, row + rect.width(), CascadeTexel());
+            }
+        }
+
+        const int sourceLayer = level + 1;
+        if (sourceLayer > highest) continue;
+
+        //the first tiled level merges from a full layer, the rest from the tile above
+        const LayerView source = sourceLayer < tiledLevels
+                                     ? views[sourceLayer]
+                                     : LayerView{layerData(sourceLayer), FULL_LAYER};
+        const int targetSide = CASCADE_PROBE_SIDES[level];
+        const int sourceSide = CASCADE_PROBE_SIDES[sourceLayer];
+        for (int y = rect.y0; y < rect.y1; y++) {
+            for (int x = rect.x0; x < rect.x1; x++) {
+                mergeTexel(view.at(x, y), source, targetSide, sourceSide, settings_.merge, x, y);
+            }
+        }
+    }
+
+    const int side = CASCADE_PROBE_SIDES[screenLayer];
+    for (int y = y0; y < y1; y++) {
+        float* row = image_.data() + static_cast<size_t>(y) * CASCADE_TEXTURE_SIDE * 3;
+        for (int x = x0; x < x1; x++) {
+            screenPixel(row + x * 3, views[screenLayer], side, settings_.interpolate, x, y);
+        }
+    }
+}
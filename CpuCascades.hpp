@@ -0,0 +1,94 @@
+/*
+ * Multithreaded CPU version of the cascade pipeline in GLMain.cpp.
+ *
+ * gather()      - Cascade.comp, one DDA ray per texel of every gathered level
+ * merge()       - MergeCascades.comp, top-down bilinear merge into layer 0
+ * screenWrite() - ScreenWrite.frag, probe averaging + bilinear interpolation + gamma
+ *
+ * Usage: build a SceneBitmap, create a CpuCascades for it and call run(). The results live in
+ * plain host buffers: layer() gives a cascade layer with the same layout as the GL texture
+ * array, image() the final RGB image. The scene has to outlive the CpuCascades object.
+ *
+ * With Settings::tiled, run() only keeps full layers for the levels from tiledLevels up. The
+ * levels below that are gathered, merged and written to the screen one tile at a time, each level
+ * covering the tile plus the probes the bilinear lookups of the level below reach (1 probe per
+ * side). A tile's levels fit in L2, so the low levels never go through memory as full layers.
+ * The halos grow with the probe size, which is why the high levels stay full layers: tiling them
+ * would gather most of their (expensive) rays several times. In tiled mode layer() isn't
+ * written for the tiled levels.
+ */
+#pragma once
+
+#include <vector>
+
+#include "CpuRayMarch.hpp"
+#include "DistanceField.hpp"
+#include "PackedSceneBitmap.hpp"
+#include "SceneBitmap.hpp"
+#include "TaskScheduler.hpp"
+
+//All levels are gathered in one go on a work-stealing TaskScheduler, split into tasks of about
+//equal cost, so the long rays of the high levels don't leave cores idle at the end.
+class CpuCascades {
+public:
+    struct Settings {
+        int cascadeCount = 6;         //levels that get gathered, CASCADE_COUNT in GLMain.cpp
+        int highestLayer = 6;         //merging starts from this layer
+        int rayLengthMultiplier = 1;  //scroll wheel value in GLMain.cpp
+        bool merge = true;            //_Merge in MergeCascades.comp
+        bool interpolate = true;      //_Interpolate in ScreenWrite.frag
+        int screenLayer = 0;          //_Layer in ScreenWrite.frag
+        unsigned threadCount = 0;     //0 = one thread per core
+        bool simd = true;             //march packets of rays with AVX2/SSE2
+        bool packedBitmap = false;    //march a PackedSceneBitmap, scalar but skips empty space
+        bool sphereTrace = false;     //sphere trace a DistanceField, scalar, overrides packedBitmap
+        bool tiled = false;           //depth-first evaluation of the low levels, see above
+        int tileSize = 64;            //screen pixels per tile side
+        int tiledLevels = 2;          //levels below this one are evaluated per tile
+    };
+
+    explicit CpuCascades(const SceneBitmap& scene);
+    CpuCascades(const SceneBitmap& scene, const Settings& settings);
+
+    Settings& settings() { return settings_; }
+    const Settings& settings() const { return settings_; }
+
+    void gather();
+    void merge();
+    void screenWrite();
+
+    // single steps of gather() and merge(), for timing them separately
+    void gatherLevel(int level);
+    void mergeLayer(int sourceLayer);  //sourceLayer into sourceLayer - 1
+
+    // gather() + merge() + screenWrite(), or the tiled version of that
+    void run();
+
+    // CASCADE_TEXTURE_SIDE x CASCADE_TEXTURE_SIDE texels, row by row
+    const CascadeTexel* layer(int index) const;
+    // CASCADE_TEXTURE_SIDE x CASCADE_TEXTURE_SIDE RGB pixels, row by row
+    const std::vector<float>& image() const { return image_; }
+
+    unsigned threadCount() const { return scheduler_.size(); }
+
+private:
+    CascadeTexel* layerData(int index);
+
+    void prepareScene();
+    const PackedSceneBitmap* packedScene() const;
+    const DistanceField* distanceField() const;
+
+    void gatherLevels(int first, int last);
+    void gatherRows(int level, int rowBegin, int rowEnd);
+    void mergeLayers(int highestSource, int lowestSource);
+    void evaluateTile(int x0, int y0, int x1, int y1);
+
+    const SceneBitmap* scene_;
+    PackedSceneBitmap packedScene_;  //only built with Settings::packedBitmap
+    DistanceField distanceField_;    //only built with Settings::sphereTrace
+    Settings settings_;
+    TaskScheduler scheduler_;
+
+    std::vector<CascadeTexel> cascades_;  //CASCADE_LAYER_COUNT layers, like the GL texture array
+    std::vector<float> image_;
+};
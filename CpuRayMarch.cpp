@@ -0,0 +1,426 @@
+#include "CpuRayMarch.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "CpuRayMarchSimd.hpp"
+#include "DistanceField.hpp"
+#include "PackedSceneBitmap.hpp"
+
+#if defined(RC_CPU_AVX2) && defined(_MSC_VER)
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
+namespace {
+
+enum class PacketPath { Avx2, Sse2, Scalar };
+
+PacketPath detectPacketPath() {
+    if (CpuRayMarch::avx2Supported()) return PacketPath::Avx2;
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    return PacketPath::Sse2;
+#else
+    return PacketPath::Scalar;
+#endif
+}
+
+const PacketPath PACKET_PATH = detectPacketPath();
+
+//cells [x0, x1) x [y0, y1) that are all empty
+struct EmptyRect {
+    int x0, y0, x1, y1;
+};
+
+//the run of empty blocks starting at block (blockX, blockY) in direction step, in cells
+EmptyRect emptyRectX(const PackedSceneBitmap& bitmap, int blockX, int blockY, int step) {
+    const int run = bitmap.emptyBlockRunX(blockX, blockY, step);
+    const int first = step > 0 ? blockX : blockX - run + 1;
+    return {first << PackedSceneBitmap::BLOCK_SHIFT, blockY << PackedSceneBitmap::BLOCK_SHIFT,
+            std::min(bitmap.width(), (first + run) << PackedSceneBitmap::BLOCK_SHIFT),
+            std::min(bitmap.height(), (blockY + 1) << PackedSceneBitmap::BLOCK_SHIFT)};
+}
+
+EmptyRect emptyRectY(const PackedSceneBitmap& bitmap, int blockX, int blockY, int step) {
+    const int run = bitmap.emptyBlockRunY(blockX, blockY, step);
+    const int first = step > 0 ? blockY : blockY - run + 1;
+    return {blockX << PackedSceneBitmap::BLOCK_SHIFT, first << PackedSceneBitmap::BLOCK_SHIFT,
+            std::min(bitmap.width(), (blockX + 1) << PackedSceneBitmap::BLOCK_SHIFT),
+            std::min(bitmap.height(), (first + run) << PackedSceneBitmap::BLOCK_SHIFT)};
+}
+
+//DDA steps along one axis until the cell leaves [lo, hi), 0 if the ray doesn't move on that axis
+int stepsToLeave(int cell, int step, int lo, int hi) {
+    if (step > 0) return hi - cell;
+    if (step < 0) return cell - lo + 1;
+    return 0;
+}
+
+//how many of the steps along an axis with the given start distance and unit step come before
+//distance 'until' (or at it, when inclusive). capped to 'max'
+int stepsBefore(float dist, float unit, float until, bool inclusive, int max) {
+    auto before = [&](int n) {
+        const float d = dist + static_cast<float>(n) * unit;
+        return inclusive ? d <= until : d < until;
+    };
+    if (max <= 0 || !before(0)) return 0;
+    const float estimate = (until - dist) / unit;
+    int n = estimate < static_cast<float>(max) ? static_cast<int>(estimate) + 1 : max;
+    //the division rounds differently than the DDA's sums, walk to the exact count
+    while (n > 0 && !before(n - 1)) n--;
+    while (n < max && before(n)) n++;
+    return n;
+}
+
+// Moves the DDA through a rect of empty cells it's in, up to (not including) the step that takes
+// it out, the same way the step by step loop would. Returns the amount of steps taken.
+int skipEmptyRect(DdaState& dda, const EmptyRect& rect, float& prevDist, float& t) {
+    const int leaveX = stepsToLeave(dda.cellX, dda.stepX, rect.x0, rect.x1);
+    const int leaveY = stepsToLeave(dda.cellY, dda.stepY, rect.y0, rect.y1);
+
+    //distance of the step that leaves the rect on each axis. on a tie the DDA steps y first
+    constexpr float NEVER = std::numeric_limits<float>::infinity();
+    const float exitX =
+        leaveX > 0 ? dda.distToEdgeX + static_cast<float>(leaveX - 1) * dda.unitStepX : NEVER;
+    const float exitY =
+        leaveY > 0 ? dda.distToEdgeY + static_cast<float>(leaveY - 1) * dda.unitStepY : NEVER;
+
+    int stepsX, stepsY;
+    if (exitX < exitY) {
+        stepsX = leaveX - 1;
+        stepsY = stepsBefore(dda.distToEdgeY, dda.unitStepY, exitX, true, leaveY - 1);
+    } else {
+        stepsY = leaveY - 1;
+        stepsX = stepsBefore(dda.distToEdgeX, dda.unitStepX, exitY, false, leaveX - 1);
+    }
+    if (stepsX + stepsY == 0) return 0;
+
+    //distances only ever grow, so t moves by the distance of the last step taken
+    float lastDist = prevDist;
+    if (stepsX > 0) {
+        lastDist = std::fmax(lastDist,
+                             dda.distToEdgeX + static_cast<float>(stepsX - 1) * dda.unitStepX);
+    }
+    if (stepsY > 0) {
+        lastDist = std::fmax(lastDist,
+                             dda.distToEdgeY + static_cast<float>(stepsY - 1) * dda.unitStepY);
+    }
+    t += lastDist - prevDist;
+    prevDist = lastDist;
+
+    dda.cellX += stepsX * dda.stepX;
+    dda.cellY += stepsY * dda.stepY;
+    dda.distToEdgeX += static_cast<float>(stepsX) * dda.unitStepX;
+    dda.distToEdgeY += static_cast<float>(stepsY) * dda.unitStepY;
+    return stepsX + stepsY;
+}
+
+// Moves the ray to distance s from its origin and sets up the DDA for the cell it lands in, like
+// JumpAlongRay() in Cascade.comp. Returns the amount of DDA steps that got skipped.
+int jumpAlongRay(DdaState& dda, const CascadeRay& ray, float s, float& prevDist, float& t) {
+    const int startX = dda.cellX;
+    const int startY = dda.cellY;
+    dda.cellX = static_cast<int>(std::floor(ray.ox + ray.dx * s));
+    dda.cellY = static_cast<int>(std::floor(ray.oy + ray.dy * s));
+    if (dda.stepX != 0) {
+        const float nextEdge = static_cast<float>(dda.cellX + (dda.stepX > 0));
+        dda.distToEdgeX = std::max((nextEdge - ray.ox) / ray.dx, s);
+    }
+    if (dda.stepY != 0) {
+        const float nextEdge = static_cast<float>(dda.cellY + (dda.stepY > 0));
+        dda.distToEdgeY = std::max((nextEdge - ray.oy) / ray.dy, s);
+    }
+    t += s - prevDist;
+    prevDist = s;
+    return std::abs(dda.cellX - startX) + std::abs(dda.cellY - startY);
+}
+
+}  // namespace
+
+namespace CpuRayMarch {
+
+CascadeRay setupRay(int level, int x, int y, int bitmapWidth, int bitmapHeight,
+                    int rayLengthMultiplier) {
+    const int side = CASCADE_PROBE_SIDES[level];
+    const int rayCount = side * side;
+
+    const float scaleX = static_cast<float>(bitmapWidth) / static_cast<float>(CASCADE_TEXTURE_SIDE);
+    const float scaleY = static_cast<float>(bitmapHeight) / static_cast<float>(CASCADE_TEXTURE_SIDE);
+
+    //scale up probe coordinates to cover bitmap
+    const float pcX = (static_cast<float>(x - x % side) + static_cast<float>(side) * 0.5f) * scaleX;
+    const float pcY = (static_cast<float>(y - y % side) + static_cast<float>(side) * 0.5f) * scaleY;
+
+    const int ri = (y % side) * side + (x % side);
+    const float angle = 2.f * PI * ((static_cast<float>(ri) + 0.5f) / static_cast<float>(rayCount));
+
+    CascadeRay ray;
+    ray.dx = std::cos(angle);
+    ray.dy = std::sin(angle);
+
+    //shoot rays from probe centers, offset by the lengths of all lower levels
+    ray.ox = pcX;
+    ray.oy = pcY;
+    for (int i = 0; i < level; i++) {
+        const float length = CASCADE_RAY_LENGTHS[i] * static_cast<float>(rayLengthMultiplier);
+        ray.ox += ray.dx * length;
+        ray.oy += ray.dy * length;
+    }
+
+    const float offsetX = ray.ox - pcX;
+    const float offsetY = ray.oy - pcY;
+    ray.t = std::sqrt(offsetX * offsetX + offsetY * offsetY);
+    ray.maxDistance = ray.t + CASCADE_RAY_LENGTHS[level];
+    ray.maxSteps = cascadeMaxRaySteps(level);
+    return ray;
+}
+
+DdaState beginDda(const CascadeRay& ray) {
+    DdaState dda;
+    dda.cellX = static_cast<int>(std::floor(ray.ox));
+    dda.cellY = static_cast<int>(std::floor(ray.oy));
+    const float fractX = ray.ox - static_cast<float>(dda.cellX);
+    const float fractY = ray.oy - static_cast<float>(dda.cellY);
+
+    dda.stepX = (ray.dx > 0.f) - (ray.dx < 0.f);
+    dda.stepY = (ray.dy > 0.f) - (ray.dy < 0.f);
+
+    dda.unitStepX = std::sqrt(1.f + (ray.dy / ray.dx) * (ray.dy / ray.dx));
+    dda.unitStepY = std::sqrt(1.f + (ray.dx / ray.dy) * (ray.dx / ray.dy));
+
+    // going in the direction of the ray, how far will we travel through each column/row?
+    dda.distToEdgeX = (dda.stepX >= 0 ? 1.f - fractX : fractX) * dda.unitStepX;
+    dda.distToEdgeY = (dda.stepY >= 0 ? 1.f - fractY : fractY) * dda.unitStepY;
+    return dda;
+}
+
+CascadeTexel march(const SceneBitmap& bitmap, const CascadeRay& ray) {
+    const int width = bitmap.width();
+    const int height = bitmap.height();
+    const std::uint8_t* cells = bitmap.data();
+    const int colorSplit = width / 2;
+
+    DdaState dda = beginDda(ray);
+
+    CascadeTexel result;
+    float prevDist = 0.f;
+    float rayIsAlive = 1.f;
+    float t = ray.t;
+
+    for (int i = 0; i < ray.maxSteps; i++) {
+        if (dda.cellX < 0 || dda.cellY < 0 || dda.cellX >= width || dda.cellY >= height) break;
+
+        const std::uint8_t cellData = cells[static_cast<size_t>(dda.cellY) * width + dda.cellX];
+
+        if (cellData & WALL_MASK) {
+            result.a = 1.f;
+            break;
+        }
+
+        if (cellData & EMITTER_MASK) {
+            addEmission(result, dda.cellX, colorSplit, rayIsAlive, t);
+            //emitters are opaque, the shader breaks on the next iteration
+            result.a = 1.f;
+            break;
+        }
+        if (ray.maxDistance - t <= 0.f) rayIsAlive = 0.f;
+
+        //advance DDA
+        const bool xCloser = std::abs(dda.distToEdgeX) < std::abs(dda.distToEdgeY);
+        const float nextDist = std::fmin(dda.distToEdgeX, dda.distToEdgeY);
+        t += std::abs(nextDist - prevDist);
+        prevDist = nextDist;
+
+        if (xCloser) {
+            dda.cellX += dda.stepX;
+            dda.distToEdgeX += dda.unitStepX;
+        } else {
+            dda.cellY += dda.stepY;
+            dda.distToEdgeY += dda.unitStepY;
+        }
+
+        if (t > ray.maxDistance) break;
+    }
+
+    addAmbient(result);
+    return result;
+}
+
+CascadeTexel march(const PackedSceneBitmap& bitmap, const CascadeRay& ray) {
+    const int width = bitmap.width();
+    const int height = bitmap.height();
+    const int colorSplit = width / 2;
+    constexpr int BLOCK_SHIFT = PackedSceneBitmap::BLOCK_SHIFT;
+
+    DdaState dda = beginDda(ray);
+
+    //runs of empty blocks are looked for along the axis the ray moves along the most
+    const bool alongX = std::abs(ray.dx) >= std::abs(ray.dy);
+
+    CascadeTexel result;
+    float prevDist = 0.f;
+    float rayIsAlive = 1.f;
+    float t = ray.t;
+
+    for (int i = 0; i < ray.maxSteps; i++) {
+        if (dda.cellX < 0 || dda.cellY < 0 || dda.cellX >= width || dda.cellY >= height) break;
+
+        const int blockX = dda.cellX >> BLOCK_SHIFT;
+        const int blockY = dda.cellY >> BLOCK_SHIFT;
+        if (!bitmap.blockEmpty(blockX, blockY)) {
+            if (bitmap.wall(dda.cellX, dda.cellY)) {
+                result.a = 1.f;
+                break;
+            }
+
+            if (bitmap.emitter(dda.cellX, dda.cellY)) {
+                addEmission(result, dda.cellX, colorSplit, rayIsAlive, t);
+                result.a = 1.f;
+                break;
+            }
+        } else {
+            //walk through the whole run of empty blocks at once, up to the step that leaves it
+            const EmptyRect rect =
+                alongX ? emptyRectX(bitmap, blockX, blockY, dda.stepX)
+                       : emptyRectY(bitmap, blockX, blockY, dda.stepY);
+            const int skipped = skipEmptyRect(dda, rect, prevDist, t);
+            i += skipped;
+            if (i >= ray.maxSteps || t > ray.maxDistance) break;
+        }
+        if (ray.maxDistance - t <= 0.f) rayIsAlive = 0.f;
+
+        //advance DDA
+        const bool xCloser = std::abs(dda.distToEdgeX) < std::abs(dda.distToEdgeY);
+        const float nextDist = std::fmin(dda.distToEdgeX, dda.distToEdgeY);
+        t += std::abs(nextDist - prevDist);
+        prevDist = nextDist;
+
+        if (xCloser) {
+            dda.cellX += dda.stepX;
+            dda.distToEdgeX += dda.unitStepX;
+        } else {
+            dda.cellY += dda.stepY;
+            dda.distToEdgeY += dda.unitStepY;
+        }
+
+        if (t > ray.maxDistance) break;
+    }
+
+    addAmbient(result);
+    return result;
+}
+
+CascadeTexel march(const SceneBitmap& bitmap, const DistanceField& field, const CascadeRay& ray) {
+    const int width = bitmap.width();
+    const int height = bitmap.height();
+    const std::uint8_t* cells = bitmap.data();
+    const int colorSplit = width / 2;
+
+    DdaState dda = beginDda(ray);
+
+    CascadeTexel result;
+    float prevDist = 0.f;
+    float rayIsAlive = 1.f;
+    float t = ray.t;
+
+    for (int i = 0; i < ray.maxSteps; i++) {
+        if (dda.cellX < 0 || dda.cellY < 0 || dda.cellX >= width || dda.cellY >= height) break;
+
+        //the field is between cell centers, the ray and the wall can be anywhere in their cells
+        const float safeDist = field.at(dda.cellX, dda.cellY) - SQRT2;
+        if (safeDist >= 1.f) {
+            if (safeDist >= ray.maxDistance - t) break;  //nothing left to hit in this interval
+            i += jumpAlongRay(dda, ray, prevDist + safeDist, prevDist, t);
+            if (i >= ray.maxSteps) break;  //the DDA would have run out of steps on the way
+        } else {
+            const std::uint8_t cellData = cells[static_cast<size_t>(dda.cellY) * width + dda.cellX];
+
+            if (cellData & WALL_MASK) {
+                result.a = 1.f;
+                break;
+            }
+
+            if (cellData & EMITTER_MASK) {
+                addEmission(result, dda.cellX, colorSplit, rayIsAlive, t);
+                result.a = 1.f;
+                break;
+            }
+        }
+        if (ray.maxDistance - t <= 0.f) rayIsAlive = 0.f;
+
+        //advance DDA
+        const bool xCloser = std::abs(dda.distToEdgeX) < std::abs(dda.distToEdgeY);
+        const float nextDist = std::fmin(dda.distToEdgeX, dda.distToEdgeY);
+        t += std::abs(nextDist - prevDist);
+        prevDist = nextDist;
+
+        if (xCloser) {
+            dda.cellX += dda.stepX;
+            dda.distToEdgeX += dda.unitStepX;
+        } else {
+            dda.cellY += dda.stepY;
+            dda.distToEdgeY += dda.unitStepY;
+        }
+
+        if (t > ray.maxDistance) break;
+    }
+
+    addAmbient(result);
+    return result;
+}
+
+bool avx2Supported() {
+#if defined(RC_CPU_AVX2) && (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+    return __builtin_cpu_supports("avx2");
+#elif defined(RC_CPU_AVX2) && defined(_MSC_VER)
+    //the CPU has to support AVX2 and the OS has to save the ymm registers
+    int info[4];
+    __cpuid(info, 1);
+    const bool osSavesYmm = (info[2] & (1 << 27)) && (_xgetbv(0) & 0x6) == 0x6;
+    __cpuidex(info, 7, 0);
+    return osSavesYmm && (info[1] & (1 << 5));
+#else
+    return false;
+#endif
+}
+
+int packetWidth() {
+    switch (PACKET_PATH) {
+        case PacketPath::Avx2: return 8;
+        case PacketPath::Sse2: return 4;
+        default: return 1;
+    }
+}
+
+void marchPacket(const SceneBitmap& bitmap, const CascadeRay* rays, int count,
+                 CascadeTexel* results) {
+    if (PACKET_PATH == PacketPath::Scalar) {
+        for (int i = 0; i < count; i++) results[i] = march(bitmap, rays[i]);
+        return;
+    }
+
+    DdaState ddas[8];
+    PacketLaneHit hits[8];
+    for (int i = 0; i < count; i++) ddas[i] = beginDda(rays[i]);
+
+    if (PACKET_PATH == PacketPath::Avx2) {
+        marchPacketAvx2(bitmap.data(), bitmap.width(), bitmap.height(), rays, ddas, count, hits);
+    } else {
+        marchPacketSse2(bitmap.data(), bitmap.width(), bitmap.height(), rays, ddas, count, hits);
+    }
+
+    //the light gathering part of the loop, only happens once per ray
+    const int colorSplit = bitmap.width() / 2;
+    for (int i = 0; i < count; i++) {
+        CascadeTexel texel;
+        if (hits[i].emitter) {
+            addEmission(texel, hits[i].emitterX, colorSplit, hits[i].rayIsAlive, hits[i].t);
+        }
+        texel.a = hits[i].blocked ? 1.f : 0.f;
+        addAmbient(texel);
+        results[i] = texel;
+    }
+}
+
+}  // namespace CpuRayMarch
@@ -0,0 +1,94 @@
+/*
+ * CPU port of the DDA ray march in Cascade.comp.
+ *
+ * setupRay() does what the top of Cascade.comp's main() does for one texel of a cascade layer,
+ * march() runs the DDA loop and returns the texel that would be stored in the cascade array.
+ */
+#pragma once
+
+#include <cmath>
+
+#include "CascadeConstants.hpp"
+#include "SceneBitmap.hpp"
+
+class DistanceField;
+class PackedSceneBitmap;
+
+//one texel of the cascade array. rgb = radiance, a = 1 if the ray got blocked
+struct CascadeTexel {
+    float r = 0.f;
+    float g = 0.f;
+    float b = 0.f;
+    float a = 0.f;
+};
+
+//a single ray interval, in bitmap cells
+struct CascadeRay {
+    float ox, oy;        //where the interval starts
+    float dx, dy;        //direction
+    float t;             //distance from the probe center to the interval start
+    float maxDistance;   //t at the end of the interval
+    int maxSteps;        //MAX_RAY_STEPS of the level
+};
+
+//DDA state at the start of a ray, the variables set up before the loop in Cascade.comp
+struct DdaState {
+    int cellX, cellY;
+    int stepX, stepY;
+    float unitStepX, unitStepY;      //rayUnitStepSize
+    float distToEdgeX, distToEdgeY;  //distToEdge
+};
+
+namespace CpuRayMarch {
+
+// Ray for texel (x, y) of cascade layer 'level'.
+CascadeRay setupRay(int level, int x, int y, int bitmapWidth, int bitmapHeight,
+                    int rayLengthMultiplier);
+
+DdaState beginDda(const CascadeRay& ray);
+
+// March the ray through the bitmap. Same result as the DDA loop in Cascade.comp.
+CascadeTexel march(const SceneBitmap& bitmap, const CascadeRay& ray);
+
+// Same as above on the bit-packed bitmap. Where a ray walks along a run of empty cells, it takes
+// all the steps up to its next sideways step at once. Same result as march() up to the rounding
+// of t, which gets summed up in one go instead of step by step.
+CascadeTexel march(const PackedSceneBitmap& bitmap, const CascadeRay& ray);
+
+// Sphere traces the distance field of the bitmap: wherever the field says the next cells are
+// empty, the ray jumps ahead by that distance, and it takes DDA steps near walls and emitters.
+// _SphereTrace in Cascade.comp. Same result as march() except for a ray that grazes the corner of
+// a cell now and then: after a jump the DDA distances are computed instead of summed up, so the
+// rounding can pick the other side of the corner.
+CascadeTexel march(const SceneBitmap& bitmap, const DistanceField& field, const CascadeRay& ray);
+
+// Add the light of an emitter cell hit at distance t, rayIsAlive is 0 or 1.
+// Extremely hacky way of doing colored lights, same as the shader: colorSplit is 512 on the
+// 1024 bitmap.
+inline void addEmission(CascadeTexel& texel, int cellX, int colorSplit, float rayIsAlive, float t) {
+    const float attenuation = rayIsAlive * std::exp(-AIR_ABSORPTION * t);  //beers law
+    if (cellX >= colorSplit) {
+        texel.r += attenuation * 1.f;
+        texel.g += attenuation * 0.5f;
+        texel.b += attenuation * 0.1f;
+    } else {
+        texel.g += attenuation * 0.4f;
+        texel.b += attenuation * 1.f;
+    }
+}
+
+//ambient light for nice pictures
+inline void addAmbient(CascadeTexel& texel) {
+    if (texel.r == 0.f && texel.g == 0.f && texel.b == 0.f) {
+        texel.r = texel.g = texel.b = 0.001f;
+    }
+}
+
+// Rays marchPacket() takes at once: 8 with AVX2, 4 with SSE2 and 1 when neither is available.
+int packetWidth();
+
+// Vectorized march() for up to packetWidth() rays of the same level. Same results as march().
+void marchPacket(const SceneBitmap& bitmap, const CascadeRay* rays, int count,
+                 CascadeTexel* results);
+
+}  // namespace CpuRayMarch
@@ -0,0 +1,82 @@
+//AVX2 instantiation of the packet DDA kernel, see CpuRayMarchSimd.hpp.
+//This is the only file built with AVX2 enabled, marchPacket() checks the CPU before calling it.
+#define RC_PACKET_KERNEL
+#include "CpuRayMarchSimd.hpp"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+
+namespace {
+
+struct Avx2Lanes {
+    static constexpr int WIDTH = 8;
+    using F = __m256;
+    using I = __m256i;
+
+    static F load(const float* p) { return _mm256_load_ps(p); }
+    static I loadi(const int* p) { return _mm256_load_si256(reinterpret_cast<const __m256i*>(p)); }
+    static void store(float* p, F a) { _mm256_store_ps(p, a); }
+    static void storei(int* p, I a) { _mm256_store_si256(reinterpret_cast<__m256i*>(p), a); }
+    static F zero() { return _mm256_setzero_ps(); }
+    static I zeroi() { return _mm256_setzero_si256(); }
+    static I set1i(int v) { return _mm256_set1_epi32(v); }
+
+    static F add(F a, F b) { return _mm256_add_ps(a, b); }
+    static F sub(F a, F b) { return _mm256_sub_ps(a, b); }
+    static F min(F a, F b) { return _mm256_min_ps(a, b); }
+    static F abs(F a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.f), a); }
+    static F lt(F a, F b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    static F le(F a, F b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+    static F gt(F a, F b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+    static F andf(F a, F b) { return _mm256_and_ps(a, b); }
+    static F andnot(F a, F b) { return _mm256_andnot_ps(a, b); }  //~a & b
+    static F orf(F a, F b) { return _mm256_or_ps(a, b); }
+    static int movemask(F a) { return _mm256_movemask_ps(a); }
+
+    static I addi(I a, I b) { return _mm256_add_epi32(a, b); }
+    static I andi(I a, I b) { return _mm256_and_si256(a, b); }
+    static I andnoti(I a, I b) { return _mm256_andnot_si256(a, b); }  //~a & b
+    static I ori(I a, I b) { return _mm256_or_si256(a, b); }
+    static I lti(I a, I b) { return _mm256_cmpgt_epi32(b, a); }
+    static I gei(I a, I b) {
+        return _mm256_xor_si256(_mm256_cmpgt_epi32(b, a), _mm256_set1_epi32(-1));
+    }
+    static I neqZero(I a) {
+        return _mm256_xor_si256(_mm256_cmpeq_epi32(a, _mm256_setzero_si256()),
+                                _mm256_set1_epi32(-1));
+    }
+
+    static F asF(I a) { return _mm256_castsi256_ps(a); }
+    static I asI(F a) { return _mm256_castps_si256(a); }
+
+    //32 bit gather of the byte at each cell. SceneBitmap pads its cells so the last one is safe.
+    static I fetch(const std::uint8_t* cells, int width, I cellX, I cellY, F active) {
+        const I index = _mm256_add_epi32(_mm256_mullo_epi32(cellY, _mm256_set1_epi32(width)), cellX);
+        const I data = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(),
+                                                   reinterpret_cast<const int*>(cells), index,
+                                                   asI(active), 1);
+        return _mm256_and_si256(data, _mm256_set1_epi32(0xFF));
+    }
+};
+
+}  // namespace
+
+namespace CpuRayMarch {
+
+void marchPacketAvx2(const std::uint8_t* cells, int width, int height, const CascadeRay* rays,
+                     const DdaState* ddas, int count, PacketLaneHit* hits) {
+    marchPacketKernel<Avx2Lanes>(cells, width, height, rays, ddas, count, hits);
+}
+
+}  // namespace CpuRayMarch
+
+#else
+
+namespace CpuRayMarch {
+
+void marchPacketAvx2(const std::uint8_t*, int, int, const CascadeRay*, const DdaState*, int,
+                     PacketLaneHit*) {}
+
+}  // namespace CpuRayMarch
+
+#endif
@@ -0,0 +1,149 @@
+/*
+ * Internal header for CpuRayMarch::marchPacket(), only included by CpuRayMarch*.cpp.
+ *
+ * The DDA loop of Cascade.comp written once against a set of lane operations, and instantiated
+ * for AVX2 (8 lanes) in CpuRayMarchAvx2.cpp and SSE2 (4 lanes) in CpuRayMarchSse2.cpp. The AVX2
+ * file is the only one compiled with AVX2 enabled, so it must not call any inline function it
+ * shares with the rest of the program (the linker could pick its copy for everyone). That's why
+ * the kernel only reports where each lane ended and marchPacket() turns that into radiance.
+ */
+#pragma once
+
+#include <cstdint>
+
+#include "CpuRayMarch.hpp"
+
+//where a lane of a packet stopped
+struct PacketLaneHit {
+    int emitterX;      //cell x of the emitter that was hit
+    float t;           //distance the emitter was hit at
+    float rayIsAlive;  //rayIsAlive at the hit
+    bool blocked;      //a wall or an emitter stopped the ray
+    bool emitter;      //an emitter stopped the ray
+};
+
+namespace CpuRayMarch {
+
+bool avx2Supported();
+
+// Rays in a packet share their level, so maxSteps has to be the same for all of them.
+void marchPacketAvx2(const std::uint8_t* cells, int width, int height, const CascadeRay* rays,
+                     const DdaState* ddas, int count, PacketLaneHit* hits);
+void marchPacketSse2(const std::uint8_t* cells, int width, int height, const CascadeRay* rays,
+                     const DdaState* ddas, int count, PacketLaneHit* hits);
+
+}  // namespace CpuRayMarch
+
+#ifdef RC_PACKET_KERNEL
+namespace {
+
+// Lanes has to provide the vector types F (float) and I (int32), masks are float vectors with
+// all bits set in active lanes.
+template <class Lanes>
+void marchPacketKernel(const std::uint8_t* cells, int width, int height, const CascadeRay* rays,
+                       const DdaState* ddas, int count, PacketLaneHit* hits) {
+    using F = typename Lanes::F;
+    using I = typename Lanes::I;
+    constexpr int W = Lanes::WIDTH;
+
+    alignas(32) int cellX[W], cellY[W], stepX[W], stepY[W];
+    alignas(32) int valid[W];
+    alignas(32) float unitX[W], unitY[W], distX[W], distY[W], t[W], maxDistance[W];
+    for (int lane = 0; lane < W; lane++) {
+        //unused lanes duplicate lane 0 and start out dead
+        const int src = lane < count ? lane : 0;
+        cellX[lane] = ddas[src].cellX;
+        cellY[lane] = ddas[src].cellY;
+        stepX[lane] = ddas[src].stepX;
+        stepY[lane] = ddas[src].stepY;
+        unitX[lane] = ddas[src].unitStepX;
+        unitY[lane] = ddas[src].unitStepY;
+        distX[lane] = ddas[src].distToEdgeX;
+        distY[lane] = ddas[src].distToEdgeY;
+        t[lane] = rays[src].t;
+        maxDistance[lane] = rays[src].maxDistance;
+        valid[lane] = lane < count ? -1 : 0;
+
+        hits[lane] = PacketLaneHit{0, 0.f, 0.f, false, false};
+    }
+
+    I vCellX = Lanes::loadi(cellX);
+    I vCellY = Lanes::loadi(cellY);
+    const I vStepX = Lanes::loadi(stepX);
+    const I vStepY = Lanes::loadi(stepY);
+    const F vUnitX = Lanes::load(unitX);
+    const F vUnitY = Lanes::load(unitY);
+    F vDistX = Lanes::load(distX);
+    F vDistY = Lanes::load(distY);
+    F vT = Lanes::load(t);
+    const F vMaxDistance = Lanes::load(maxDistance);
+    F vPrevDist = Lanes::zero();
+
+    const I vWidth = Lanes::set1i(width);
+    const I vHeight = Lanes::set1i(height);
+    const I vZeroI = Lanes::zeroi();
+    const I vWallMask = Lanes::set1i(WALL_MASK);
+    const I vEmitterMask = Lanes::set1i(EMITTER_MASK);
+
+    F active = Lanes::asF(Lanes::loadi(valid));
+    F alive = active;  //rayIsAlive as a mask
+    const int maxSteps = rays[0].maxSteps;
+
+    for (int i = 0; i < maxSteps; i++) {
+        //out of bounds kills the ray
+        const I outside =
+            Lanes::ori(Lanes::ori(Lanes::lti(vCellX, vZeroI), Lanes::lti(vCellY, vZeroI)),
+                       Lanes::ori(Lanes::gei(vCellX, vWidth), Lanes::gei(vCellY, vHeight)));
+        active = Lanes::andnot(Lanes::asF(outside), active);
+        if (Lanes::movemask(active) == 0) break;
+
+        //get object data of the current cell
+        const I cellData = Lanes::fetch(cells, width, vCellX, vCellY, active);
+        const F isWall = Lanes::asF(Lanes::neqZero(Lanes::andi(cellData, vWallMask)));
+        const F isEmitter = Lanes::asF(Lanes::neqZero(Lanes::andi(cellData, vEmitterMask)));
+        const F blocks = Lanes::andf(active, isWall);
+        const F emits = Lanes::andnot(blocks, Lanes::andf(active, isEmitter));
+
+        const int stopped = Lanes::movemask(Lanes::orf(blocks, emits));
+        if (stopped != 0) {
+            const int emitted = Lanes::movemask(emits);
+            const int aliveBits = Lanes::movemask(alive);
+            alignas(32) int hitX[W];
+            alignas(32) float hitT[W];
+            Lanes::storei(hitX, vCellX);
+            Lanes::store(hitT, vT);
+            for (int lane = 0; lane < W; lane++) {
+                if (!(stopped & (1 << lane))) continue;
+                hits[lane].blocked = true;
+                if (emitted & (1 << lane)) {
+                    hits[lane].emitter = true;
+                    hits[lane].emitterX = hitX[lane];
+                    hits[lane].t = hitT[lane];
+                    hits[lane].rayIsAlive = (aliveBits & (1 << lane)) ? 1.f : 0.f;
+                }
+            }
+            active = Lanes::andnot(Lanes::orf(blocks, emits), active);
+        }
+
+        //rays that walked past their interval stop gathering light
+        const F pastEnd = Lanes::le(Lanes::sub(vMaxDistance, vT), Lanes::zero());
+        alive = Lanes::andnot(Lanes::andf(active, pastEnd), alive);
+
+        //advance DDA
+        const F xCloser = Lanes::lt(Lanes::abs(vDistX), Lanes::abs(vDistY));
+        const F nextDist = Lanes::min(vDistX, vDistY);
+        vT = Lanes::add(vT, Lanes::abs(Lanes::sub(nextDist, vPrevDist)));
+        vPrevDist = nextDist;
+
+        const I xCloserI = Lanes::asI(xCloser);
+        vCellX = Lanes::addi(vCellX, Lanes::andi(xCloserI, vStepX));
+        vCellY = Lanes::addi(vCellY, Lanes::andnoti(xCloserI, vStepY));
+        vDistX = Lanes::add(vDistX, Lanes::andf(xCloser, vUnitX));
+        vDistY = Lanes::add(vDistY, Lanes::andnot(xCloser, vUnitY));
+
+        active = Lanes::andnot(Lanes::gt(vT, vMaxDistance), active);
+    }
+}
+
+}  // namespace
+#endif
@@ -0,0 +1,84 @@
+//SSE2 instantiation of the packet DDA kernel, see CpuRayMarchSimd.hpp
+#define RC_PACKET_KERNEL
+#include "CpuRayMarchSimd.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+
+namespace {
+
+struct Sse2Lanes {
+    static constexpr int WIDTH = 4;
+    using F = __m128;
+    using I = __m128i;
+
+    static F load(const float* p) { return _mm_load_ps(p); }
+    static I loadi(const int* p) { return _mm_load_si128(reinterpret_cast<const __m128i*>(p)); }
+    static void store(float* p, F a) { _mm_store_ps(p, a); }
+    static void storei(int* p, I a) { _mm_store_si128(reinterpret_cast<__m128i*>(p), a); }
+    static F zero() { return _mm_setzero_ps(); }
+    static I zeroi() { return _mm_setzero_si128(); }
+    static I set1i(int v) { return _mm_set1_epi32(v); }
+
+    static F add(F a, F b) { return _mm_add_ps(a, b); }
+    static F sub(F a, F b) { return _mm_sub_ps(a, b); }
+    static F min(F a, F b) { return _mm_min_ps(a, b); }
+    static F abs(F a) { return _mm_andnot_ps(_mm_set1_ps(-0.f), a); }
+    static F lt(F a, F b) { return _mm_cmplt_ps(a, b); }
+    static F le(F a, F b) { return _mm_cmple_ps(a, b); }
+    static F gt(F a, F b) { return _mm_cmpgt_ps(a, b); }
+    static F andf(F a, F b) { return _mm_and_ps(a, b); }
+    static F andnot(F a, F b) { return _mm_andnot_ps(a, b); }  //~a & b
+    static F orf(F a, F b) { return _mm_or_ps(a, b); }
+    static int movemask(F a) { return _mm_movemask_ps(a); }
+
+    static I addi(I a, I b) { return _mm_add_epi32(a, b); }
+    static I andi(I a, I b) { return _mm_and_si128(a, b); }
+    static I andnoti(I a, I b) { return _mm_andnot_si128(a, b); }  //~a & b
+    static I ori(I a, I b) { return _mm_or_si128(a, b); }
+    static I lti(I a, I b) { return _mm_cmplt_epi32(a, b); }
+    static I gei(I a, I b) { return _mm_xor_si128(_mm_cmplt_epi32(a, b), _mm_set1_epi32(-1)); }
+    static I neqZero(I a) {
+        return _mm_xor_si128(_mm_cmpeq_epi32(a, _mm_setzero_si128()), _mm_set1_epi32(-1));
+    }
+
+    static F asF(I a) { return _mm_castsi128_ps(a); }
+    static I asI(F a) { return _mm_castps_si128(a); }
+
+    //no gather in SSE, fetch lane by lane
+    static I fetch(const std::uint8_t* cells, int width, I cellX, I cellY, F active) {
+        alignas(16) int x[WIDTH], y[WIDTH], data[WIDTH];
+        storei(x, cellX);
+        storei(y, cellY);
+        const int activeBits = movemask(active);
+        for (int lane = 0; lane < WIDTH; lane++) {
+            data[lane] = (activeBits & (1 << lane))
+                             ? cells[static_cast<size_t>(y[lane]) * static_cast<size_t>(width) +
+                                     static_cast<size_t>(x[lane])]
+                             : 0;
+        }
+        return loadi(data);
+    }
+};
+
+}  // namespace
+
+namespace CpuRayMarch {
+
+void marchPacketSse2(const std::uint8_t* cells, int width, int height, const CascadeRay* rays,
+                     const DdaState* ddas, int count, PacketLaneHit* hits) {
+    marchPacketKernel<Sse2Lanes>(cells, width, height, rays, ddas, count, hits);
+}
+
+}  // namespace CpuRayMarch
+
+#else
+
+namespace CpuRayMarch {
+
+void marchPacketSse2(const std::uint8_t*, int, int, const CascadeRay*, const DdaState*, int,
+                     PacketLaneHit*) {}
+
+}  // namespace CpuRayMarch
+
+#endif
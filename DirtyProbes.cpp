@@ -0,0 +1,121 @@
+#include "DirtyProbes.hpp"
+
+#include <algorithm>
+#include <climits>
+
+#include "CascadeConstants.hpp"
+#include "Profiling.hpp"
+
+namespace {
+
+DirtyProbes::Rect join(const DirtyProbes::Rect& a, const DirtyProbes::Rect& b) {
+    return {std::min(a.x0, b.x0), std::min(a.y0, b.y0), std::max(a.x1, b.x1),
+            std::max(a.y1, b.y1)};
+}
+
+bool touch(const DirtyProbes::Rect& a, const DirtyProbes::Rect& b) {
+    return a.x0 <= b.x1 && b.x0 <= a.x1 && a.y0 <= b.y1 && b.y0 <= a.y1;
+}
+
+long long area(const DirtyProbes::Rect& r) {
+    return static_cast<long long>(r.x1 - r.x0) * (r.y1 - r.y0);
+}
+
+}  // namespace
+
+DirtyProbes::DirtyProbes(int bitmapWidth, int bitmapHeight)
+    : bitmapWidth_(bitmapWidth)
+    , bitmapHeight_(bitmapHeight)
+    , shader_("shaders/MarkDirtyProbes.comp") {
+    //one flag per texel of the cascade array. it's only used as an image, so put back whatever
+    //array the active texture unit had (the cascades if it's unit 2)
+    GLint previous;
+    glGetIntegerv(GL_TEXTURE_BINDING_2D_ARRAY, &previous);
+    glGenTextures(1, &mask_);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, mask_);
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_R8UI, CASCADE_TEXTURE_SIDE, CASCADE_TEXTURE_SIDE,
+                   CASCADE_LAYER_COUNT);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, static_cast<GLuint>(previous));
+    glBindImageTexture(1, mask_, 0, GL_TRUE, 0, GL_READ_WRITE, GL_R8UI);
+
+    levelLoc_ = glGetUniformLocation(shader_.id(), "_Level");
+    layerSideLoc_ = glGetUniformLocation(shader_.id(), "_LayerSide");
+    rayLengthMultiplierLoc_ = glGetUniformLocation(shader_.id(), "_RayLengthMultiplier");
+    mergeFromAboveLoc_ = glGetUniformLocation(shader_.id(), "_MergeFromAbove");
+    mergeLoc_ = glGetUniformLocation(shader_.id(), "_Merge");
+    rectsLoc_ = glGetUniformLocation(shader_.id(), "_DirtyRects");
+    rectCountLoc_ = glGetUniformLocation(shader_.id(), "_DirtyRectCount");
+
+    glUseProgram(shader_.id());
+    glUniform2i(glGetUniformLocation(shader_.id(), "_BitmapSize"), bitmapWidth_, bitmapHeight_);
+}
+
+DirtyProbes::~DirtyProbes() {
+    if (mask_ != 0) {
+        glDeleteTextures(1, &mask_);
+    }
+}
+
+void DirtyProbes::add(int x, int y, int w, int h) {
+    Rect rect{std::max(x, 0), std::max(y, 0), std::min(x + w, bitmapWidth_),
+              std::min(y + h, bitmapHeight_)};
+    if (rect.x0 >= rect.x1 || rect.y0 >= rect.y1) return;
+
+    //a brush stroke keeps touching the last rects, those grow into one
+    for (auto it = rects_.begin(); it != rects_.end();) {
+        if (touch(*it, rect)) {
+            rect = join(*it, rect);
+            it = rects_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    rects_.push_back(rect);
+
+    while (static_cast<int>(rects_.size()) > MAX_RECTS) {
+        size_t bestA = 0, bestB = 1;
+        long long bestGrowth = LLONG_MAX;
+        for (size_t a = 0; a < rects_.size(); a++) {
+            for (size_t b = a + 1; b < rects_.size(); b++) {
+                const long long growth =
+                    area(join(rects_[a], rects_[b])) - area(rects_[a]) - area(rects_[b]);
+                if (growth < bestGrowth) {
+                    bestGrowth = growth;
+                    bestA = a;
+                    bestB = b;
+                }
+            }
+        }
+        rects_[bestA] = join(rects_[bestA], rects_[bestB]);
+        rects_.erase(rects_.begin() + static_cast<std::ptrdiff_t>(bestB));
+    }
+}
+
+void DirtyProbes::clearMask() {
+    GLuint zero = 0;
+    glClearTexImage(mask_, 0, GL_RED_INTEGER, GL_UNSIGNED_BYTE, &zero);
+}
+
+void DirtyProbes::mark(int level, int layerSide, int rayLengthMultiplier, bool mergeFromAbove,
+                       bool merge) {
+    GLint rects[MAX_RECTS * 4] = {};
+    for (size_t i = 0; i < rects_.size(); i++) {
+        rects[i * 4 + 0] = rects_[i].x0;
+        rects[i * 4 + 1] = rects_[i].y0;
+        rects[i * 4 + 2] = rects_[i].x1;
+        rects[i * 4 + 3] = rects_[i].y1;
+    }
+
+    TracyGpuZone("mark dirty probes");
+    glUseProgram(shader_.id());
+    glUniform1i(levelLoc_, level);
+    glUniform1i(layerSideLoc_, layerSide);
+    glUniform1i(rayLengthMultiplierLoc_, rayLengthMultiplier);
+    glUniform1i(mergeFromAboveLoc_, static_cast<int>(mergeFromAbove));
+    glUniform1i(mergeLoc_, static_cast<int>(merge));
+    glUniform4iv(rectsLoc_, MAX_RECTS, rects);
+    glUniform1i(rectCountLoc_, static_cast<int>(rects_.size()));
+
+    glDispatchCompute(layerSide / 16, layerSide / 16, 1);
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);  //the level below reads these flags
+}
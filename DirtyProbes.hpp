@@ -0,0 +1,67 @@
+/*
+ * Incremental relighting: finds the cascade texels that an edit of the scene bitmap affects, so
+ * only those get gathered and merged again.
+ *
+ * add() collects the changed cells as rectangles. mark() runs MarkDirtyProbes.comp for a level,
+ * which flags every texel whose ray interval crosses a changed cell, plus every texel whose merge
+ * reads a flagged texel of the level above. Cascade.comp and MergeCascades.comp with _DirtyOnly set
+ * skip the texels that aren't flagged and keep what they hold from the last frame. The work of
+ * the gather scales with the amount of rays that cross the edit, not with the size of the scene.
+ *
+ * Usage: add() the edited cells, then once per relight: clearMask(), mark() from the highest
+ * merged level down to 0, gather + merge with _DirtyOnly = 1 and clear(). Only valid if the
+ * cascades hold a full relight made with the same settings (ray length, merge, highest layer).
+ * The mask is bound to image unit 1 on creation.
+ */
+#pragma once
+
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "Shader.hpp"
+
+class DirtyProbes {
+public:
+    static constexpr int MAX_RECTS = 8;  //MAX_DIRTY_RECTS in MarkDirtyProbes.comp
+
+    struct Rect {
+        int x0, y0, x1, y1;  //cells [x0, x1) x [y0, y1)
+    };
+
+    DirtyProbes(int bitmapWidth, int bitmapHeight);
+    ~DirtyProbes();
+
+    DirtyProbes(const DirtyProbes&) = delete;
+    DirtyProbes& operator=(const DirtyProbes&) = delete;
+
+    // Cells [x, x + w) x [y, y + h) changed. Touching rectangles are joined, and past MAX_RECTS
+    // the two that grow the least when joined are.
+    void add(int x, int y, int w, int h);
+    void clear() { rects_.clear(); }
+    bool empty() const { return rects_.empty(); }
+    const std::vector<Rect>& rects() const { return rects_; }
+
+    void clearMask();
+    // layerSide = texels per side of a level, mergeFromAbove = level + 1 gets merged into level,
+    // merge = _Merge of MergeCascades.comp
+    void mark(int level, int layerSide, int rayLengthMultiplier, bool mergeFromAbove, bool merge);
+
+    GLuint id() const { return mask_; }
+
+private:
+    int bitmapWidth_;
+    int bitmapHeight_;
+    std::vector<Rect> rects_;
+
+    GLuint mask_ = 0;
+
+    Shader shader_;
+    GLint levelLoc_;
+    GLint layerSideLoc_;
+    GLint rayLengthMultiplierLoc_;
+    GLint mergeFromAboveLoc_;
+    GLint mergeLoc_;
+    GLint rectsLoc_;
+    GLint rectCountLoc_;
+};
@@ -0,0 +1,110 @@
+#include "DistanceField.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "CascadeConstants.hpp"
+#include "TaskScheduler.hpp"
+
+namespace {
+
+//closest occupied and closest empty cell found so far, -1 = none yet. rgba16i in JumpFlood.comp
+struct Seeds {
+    std::int16_t occupiedX, occupiedY;
+    std::int16_t emptyX, emptyY;
+};
+
+float seedDistance(int seedX, int seedY, int x, int y) {
+    if (seedX < 0) return 1e30f;
+    const float dx = static_cast<float>(seedX - x);
+    const float dy = static_cast<float>(seedY - y);
+    return dx * dx + dy * dy;
+}
+
+//one JumpFlood.comp pass over row y
+void floodRow(const std::vector<Seeds>& in, std::vector<Seeds>& out, int width, int height,
+              int stepSize, int y) {
+    for (int x = 0; x < width; x++) {
+        Seeds best = in[static_cast<size_t>(y) * width + x];
+        float bestOccupied = seedDistance(best.occupiedX, best.occupiedY, x, y);
+        float bestEmpty = seedDistance(best.emptyX, best.emptyY, x, y);
+
+        for (int oy = -1; oy <= 1; oy++) {
+            const int ny = y + oy * stepSize;
+            if (ny < 0 || ny >= height) continue;
+            for (int ox = -1; ox <= 1; ox++) {
+                const int nx = x + ox * stepSize;
+                if ((ox == 0 && oy == 0) || nx < 0 || nx >= width) continue;
+
+                const Seeds& seeds = in[static_cast<size_t>(ny) * width + nx];
+                const float occupied = seedDistance(seeds.occupiedX, seeds.occupiedY, x, y);
+                if (occupied < bestOccupied) {
+                    bestOccupied = occupied;
+                    best.occupiedX = seeds.occupiedX;
+                    best.occupiedY = seeds.occupiedY;
+                }
+                const float empty = seedDistance(seeds.emptyX, seeds.emptyY, x, y);
+                if (empty < bestEmpty) {
+                    bestEmpty = empty;
+                    best.emptyX = seeds.emptyX;
+                    best.emptyY = seeds.emptyY;
+                }
+            }
+        }
+        out[static_cast<size_t>(y) * width + x] = best;
+    }
+}
+
+}  // namespace
+
+DistanceField::DistanceField(const SceneBitmap& bitmap, TaskScheduler& scheduler)
+    : width_(bitmap.width())
+    , height_(bitmap.height())
+    , distances_(static_cast<size_t>(bitmap.width()) * bitmap.height()) {
+    const size_t cellCount = distances_.size();
+    std::vector<Seeds> seeds[2] = {std::vector<Seeds>(cellCount), std::vector<Seeds>(cellCount)};
+
+    //every cell is the seed of its own kind
+    for (int y = 0; y < height_; y++) {
+        for (int x = 0; x < width_; x++) {
+            const auto cx = static_cast<std::int16_t>(x);
+            const auto cy = static_cast<std::int16_t>(y);
+            const bool occupied = bitmap.cell(x, y) & (WALL_MASK | EMITTER_MASK);
+            seeds[0][static_cast<size_t>(y) * width_ + x] =
+                occupied ? Seeds{cx, cy, -1, -1} : Seeds{-1, -1, cx, cy};
+        }
+    }
+
+    //half the bitmap down to 1, plus one more pass of 1 (JFA+1)
+    int largestStep = 1;
+    while (largestStep * 2 < std::max(width_, height_)) largestStep *= 2;
+
+    int current = 0;
+    for (int step = largestStep;; step /= 2) {
+        const int passStep = std::max(step, 1);
+        const std::vector<Seeds>& in = seeds[current];
+        std::vector<Seeds>& out = seeds[1 - current];
+        scheduler.parallelFor(0, height_, 16, [&](int y) {
+            floodRow(in, out, width_, height_, passStep, y);
+        });
+        current = 1 - current;
+        if (step == 0) break;
+    }
+
+    //same as JumpFloodResolve.comp
+    const std::vector<Seeds>& result = seeds[current];
+    for (int y = 0; y < height_; y++) {
+        for (int x = 0; x < width_; x++) {
+            const size_t index = static_cast<size_t>(y) * width_ + x;
+            const Seeds& s = result[index];
+            float distance = NO_SEED_DISTANCE;
+            if (s.occupiedX == x && s.occupiedY == y) {
+                distance = s.emptyX < 0 ? -NO_SEED_DISTANCE
+                                        : -std::sqrt(seedDistance(s.emptyX, s.emptyY, x, y));
+            } else if (s.occupiedX >= 0) {
+                distance = std::sqrt(seedDistance(s.occupiedX, s.occupiedY, x, y));
+            }
+            distances_[index] = distance;
+        }
+    }
+}
@@ -0,0 +1,36 @@
+/*
+ * Signed distance field of a SceneBitmap, made with the jump flood algorithm. CPU version of
+ * JumpFlood.hpp, same passes and the same result.
+ *
+ * at() is the distance between cell centers to the closest occupied (wall or emitter) cell, or
+ * minus the distance to the closest empty cell for occupied cells. NO_SEED_DISTANCE when the
+ * bitmap has no cell of the kind looked for.
+ */
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "SceneBitmap.hpp"
+
+class TaskScheduler;
+
+class DistanceField {
+public:
+    static constexpr float NO_SEED_DISTANCE = 1e6f;
+
+    DistanceField() = default;
+    // The flood passes run on the scheduler, one row per index.
+    DistanceField(const SceneBitmap& bitmap, TaskScheduler& scheduler);
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+    bool empty() const { return distances_.empty(); }
+
+    float at(int x, int y) const { return distances_[static_cast<size_t>(y) * width_ + x]; }
+
+private:
+    int width_ = 0;
+    int height_ = 0;
+    std::vector<float> distances_;
+};
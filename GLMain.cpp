@@ -27,6 +27,7 @@
 #include <iostream>
 // Math header for trigonometric functions
 #include <cmath>
+#include <vector>
 
 // glew provides easy access to advanced OpenGL functions and extensions
 #include <GL/glew.h>
@@ -38,15 +39,15 @@
 
 #include "Utilities.hpp"
 #include "TriangleSoup.hpp"
-#include "CascadePreprocessor.hpp"
-
-#include "Shader.hpp"
-#include "Texture.hpp"
-#include "Tracy.hpp"
-#include "TracyOpenGL.hpp"
+#include "CascadeConstants.hpp"
+#include "GpuCascades.hpp"
+#include "Profiling.hpp"    //Tracy, compiled out without it
 
 constexpr int CASCADE_COUNT = 6;
-int oldRLM = 1;
+//Tracy keeps the plot name pointers
+[[maybe_unused]] const char* const STEP_PLOTS[CASCADE_LAYER_COUNT] = {
+    "steps/ray c0", "steps/ray c1", "steps/ray c2", "steps/ray c3", "steps/ray c4", "steps/ray c5", "steps/ray c6"
+};
 int rayLengthMultiplier = 1;
 void ScrollCallback(GLFWwindow* window, double xoffset, double yoffset)
 {
@@ -56,15 +57,16 @@ void ScrollCallback(GLFWwindow* window, double xoffset, double yoffset)
     std::cout << "mod: " << rayLengthMultiplier <<"\n";
 }
 
-int main(int, char*[]) {
+bool windowNeedsRefresh = true;  //the window system lost what's on screen, show the cached frame again
+void RefreshCallback(GLFWwindow*)
+{
+    windowNeedsRefresh = true;
+}
+
+int main(int argc, char* argv[]) {
 
-    //This generates N cascade shader files and adds "#Define CASCADE_LEVEL N" when it hits the line #PreprocessCascadeLevel
-    //this is to get loop unrolling in my raymarching without having to manage 7+ files where the only difference is 1 value.
-    CascadePreprocessor::preprocessCascades(CASCADE_COUNT);
-    
     // Initialise GLFW
     glfwInit();
-    
     const GLFWvidmode* vidmode;  // GLFW struct to hold information about the display
     // Determine the desktop size
     vidmode = glfwGetVideoMode(glfwGetPrimaryMonitor());
@@ -96,7 +98,7 @@ int main(int, char*[]) {
         glfwTerminate();
         return -1;
     }
-
+    TracyGpuContext;
 
     // Show some useful information on the GL context
     std::cout << "GL vendor:       " << glGetString(GL_VENDOR)
@@ -118,221 +120,139 @@ int main(int, char*[]) {
 
 
 
-    constexpr float SQUASH = 1.f; //scalar for squashing the quad
-    //quad for writing to screen:
-    float quadVertices[] = {
-        -SQUASH, -SQUASH,    0.f, 0.f,
-         SQUASH, -SQUASH,    1.f, 0.f,
-        -SQUASH,  SQUASH,    0.f, 1.f,
-         SQUASH,  SQUASH,    1.f, 1.f,
-    };
-
-    GLuint quadVAO, quadVBO;
-    glGenVertexArrays(1, &quadVAO);
-    glGenBuffers(1, &quadVBO);
-    glBindVertexArray(quadVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
-
-    // Position attribute
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
-    // TexCoords attribute
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
-
-    glBindVertexArray(0);
-    
-
-    //----------------------------------Scene & Material Setup--------------------------------------
-    //this bitmap is the scene. it contains the wall/emissive data that the rays march against.
-    
-    std::cout << "Bitmap setup.\n";
-    
-    GLuint bitmapTex;
-    glGenTextures(1, &bitmapTex);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, bitmapTex);
-    
-    constexpr int worldWidth = 1024;
-    constexpr int worldHeight = 1024;
-    
-    glTexStorage2D(GL_TEXTURE_2D, 1, GL_R8UI, worldWidth, worldHeight);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    
-    glBindImageTexture(0, bitmapTex, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R8UI); //binding to image unit 0
-    GLuint zero = 0;
-    glClearTexImage(bitmapTex, 0, GL_RED_INTEGER, GL_UNSIGNED_BYTE, &zero);
-
-    
-    Texture worldTex("Textures/TNM061.tga"); //selects what scene to use
-    glActiveTexture(GL_TEXTURE10);
-    glBindTexture(GL_TEXTURE_2D, worldTex.id());
-    
-    Shader bitmapGenerator("shaders/GenerateSceneBitmap.comp");
-    
-    glUseProgram(bitmapGenerator.id());
-    glUniform1i(glGetUniformLocation(bitmapGenerator.id(), "sceneTexture"), 10);
-    
-    glDispatchCompute(128, 128, 1);
-    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
-
-
-    
-    //mats are not implemented yet.
-    //emissive material atlas. Each texel has a color and a brightness, that's all that materials contain for now.
-    
-    std::cout << "Material atlas setup.\n";
+    //the last ScreenWrite output. with render on demand, frames where nothing changed show this
+    //instead of running the pipeline, or don't draw at all.
+    GLuint screenCacheFBO, screenCacheTex;
+    glGenFramebuffers(1, &screenCacheFBO);
+    glGenTextures(1, &screenCacheTex);
+    int cacheWidth = 0, cacheHeight = 0;   //sized in the main loop
     
-    GLuint materialAtlas;
-    glGenTextures(1, &materialAtlas);
-    glActiveTexture(GL_TEXTURE1); //binding to texture unit 1
-    glBindTexture(GL_TEXTURE_2D, materialAtlas);
-    
-    constexpr int atlasSide = 8;
-    std::vector atlasData(atlasSide * atlasSide, glm::vec4(0,1,0,1));
-    atlasData.at(0) = glm::vec4(0,0,0,0);
-    
-    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA32F, 8,8);
-    glTexSubImage2D(GL_TEXTURE_2D, 0, 0,0,atlasSide,atlasSide,
-        GL_RGBA, GL_FLOAT, atlasData.data());
-    
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    
-
-
-
 
     //----------------------------------Cascade Setup--------------------------------------
+    //the scene bitmap, its acceleration structures, the cascade array and the shaders that run on it.
+    //This generates N cascade shader files and adds "#Define CASCADE_LEVEL N" when it hits the line #PreprocessCascadeLevel
+    //this is to get loop unrolling in my raymarching without having to manage 7+ files where the only difference is 1 value.
+    std::cout << "Cascade setup.\n";
+    GpuCascades cascades(argc > 1 ? argv[1] : "Textures/TNM061.tga", CASCADE_COUNT); //selects what scene to use
+    GpuCascades::Settings& settings = cascades.settings();
+    GpuProfiler& profiler = cascades.profiler();   //GPU time of every dispatch, read back frames later. P prints it
+    profiler.setEnabled(true);
+    constexpr int worldWidth = GpuCascades::WORLD_WIDTH;
+    constexpr int worldHeight = GpuCascades::WORLD_HEIGHT;
+
+    constexpr int BRUSH_SIZE = 16;  //cells per side of the square painted with the mouse
+    int lastPaintX = -1, lastPaintY = -1;
+    GLubyte lastPaintValue = 0;
     
-    std::cout << "cascade image array setup.\n";
-    GLuint cascadeTextures;
-    glGenTextures(1, &cascadeTextures);
-    glActiveTexture(GL_TEXTURE2); //binding to texture unit 2
-    glBindTexture(GL_TEXTURE_2D_ARRAY, cascadeTextures);
-    
-    glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_RGBA16F, 1024, 1024, 7);
-    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-    //bind to image unit 2
-    glBindImageTexture(2, cascadeTextures, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA16F);
-
-    
-
-    //rebind bitmap to TU 0 for sampling. this shouldn't be necessary as bindings are global,
-    //but had issues where the binding got lost and the scenetexture was read instead. I will look to remove this later.
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, bitmapTex);
-    
-    Shader cascades[CASCADE_COUNT] = {
-        Shader("shaders/generated/Cascade0.comp"),
-        Shader("shaders/generated/Cascade1.comp"),
-        Shader("shaders/generated/Cascade2.comp"),
-        Shader("shaders/generated/Cascade3.comp"),
-        Shader("shaders/generated/Cascade4.comp"),
-        Shader("shaders/generated/Cascade5.comp"),
-        //Shader("shaders/generated/Cascade6.comp"),
-    };
-
-    GLint rayLMLoc[CASCADE_COUNT];
-    for(int i = 0; i < CASCADE_COUNT; i++) {
-        glUseProgram(cascades[i].id());
-        glUniform1i(glGetUniformLocation(cascades[i].id(), "_bitmapTexture"), 0);
-        rayLMLoc[i] = glGetUniformLocation(cascades[i].id(), "_RayLengthMultiplier");
-        glUniform1i(rayLMLoc[i], rayLengthMultiplier);
-    }
-
-    
-    //-----------------------------------MERGE CASCADES---------------------------------------------
-
-    std::cout << "merge setup.\n";
-    Shader merge("shaders/MergeCascades.comp");
-    
-    glUseProgram(merge.id());
-    glUniform1i(glGetUniformLocation(merge.id(), "_cascadeSamplers"), 2);
-    GLint mergeLoc = glGetUniformLocation(merge.id(), "_Merge");
-    glUniform1i(mergeLoc, 1);
-
-    GLint _sourceLaterIndexLoc = glGetUniformLocation(merge.id(), "_sourceLayerIndex");
-    for(int i = 6; i > 0; i--) {
-        glUniform1i(_sourceLaterIndexLoc, i);
-        glDispatchCompute(64, 64, 1);
-        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
-    }
+    bool renderOnDemand = true;     //only run the pipeline when something changed and sleep in between
+    bool screenDirty = true;        //the screen cache doesn't show the current cascades/ScreenWrite settings
+    constexpr double IDLE_WAIT_TIME = 0.25;  //seconds to block for events when idle, keeps the fps display and key pauses going
 
-
-    //-----------------------------------WRITE TO SCREEN--------------------------------------------  
-    
-    std::cout << "ScreenWrite setup.\n";
-    Shader screenWrite("shaders/ScreenWrite.vert", "shaders/ScreenWrite.frag");
-    glUseProgram(screenWrite.id());
-    GLint swLayerLoc = glGetUniformLocation(screenWrite.id(), "_Layer");
-    glUniform1i(swLayerLoc, 0);
-    GLint swInterpLoc = glGetUniformLocation(screenWrite.id(), "_Interpolate");
-    glUniform1i(swInterpLoc, 1);
-    GLint swUVLoc = glGetUniformLocation(screenWrite.id(), "_ProbeUV");
-    glUniform1i(swUVLoc, 0);
-
-    bool applyMerge = true;
-    bool interpolate = true;
-    bool probeUV = false;
-    int highestLayer = 6;
-    
-    int defaultInputPauseTime = 1000;
-    int inputPauseTime = 150;
-    int timePaused = 0;
+    //in seconds, frame times vary too much with render on demand to count frames
+    double defaultInputPauseTime = 0.3;
+    double inputPauseTime = 0.15;
+    double timePaused = 0;          //when the last key got handled, 0 = taking input
 
     
     
     //----------------------------------------MAIN LOOP---------------------------------------------
     std::cout << "main loop\n";
+    glfwSetWindowRefreshCallback(window, RefreshCallback);
     while (!glfwWindowShouldClose(window)) {
         ZoneScoped;
+        profiler.beginFrame();
         // Set the clear color to a dark gray (RGBA)
         glClearColor(0.3f, 0.3f, 0.3f, 0.0f);
         // Clear the color and depth buffers for drawing
         glfwSetScrollCallback(window, ScrollCallback);
-        
-        if (glfwGetKey(window, GLFW_KEY_SPACE)) {
-            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-            
-            //-------------------------------GATHER RAYS--------------------------------------------
-
-            for(int i = 0; i < CASCADE_COUNT; i++) {
-               std::string msg = "c" + std::to_string(i);
-               TracyMessage(msg.c_str(), msg.length());
-               glUseProgram(cascades[i].id());
-               glDispatchCompute(64, 64, 1);
-            }
 
-            //-------------------------------MERGE RAYS---------------------------------------------
-            glUseProgram(merge.id());
-            glUniform1i(glGetUniformLocation(merge.id(), "_cascadeSamplers"), 2);
-            for(int i = highestLayer; i > 0; i--) {
-                std::string msg = "c" + std::to_string(i);
-                TracyMessage(msg.c_str(), msg.length());
-                glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
-                glUniform1i(glGetUniformLocation(merge.id(), "_sourceLayerIndex"), i);
-                glDispatchCompute(64, 64, 1);
+        //the screen cache follows the window size
+        glfwGetFramebufferSize(window, &width, &height);
+        if ((width != cacheWidth || height != cacheHeight) && width > 0 && height > 0) {
+            cacheWidth = width;
+            cacheHeight = height;
+            GpuCascades::bindScratchUnit();
+            glBindTexture(GL_TEXTURE_2D, screenCacheTex);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glBindFramebuffer(GL_FRAMEBUFFER, screenCacheFBO);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, screenCacheTex, 0);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            glViewport(0, 0, width, height);
+            screenDirty = true;     //the cascades don't depend on the window, only ScreenWrite has to run again
+        }
+
+        //-------------------------------EDIT SCENE-------------------------------------------------
+        //left mouse paints walls, shift + left mouse emitters, right mouse erases
+        bool paintLeft = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
+        bool paintRight = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_RIGHT) == GLFW_PRESS;
+        if (paintLeft || paintRight) {
+            double cursorX, cursorY;
+            glfwGetCursorPos(window, &cursorX, &cursorY);
+            glfwGetWindowSize(window, &width, &height);
+            //the bitmap's first row is at the bottom of the window
+            int paintX = static_cast<int>(cursorX / width * worldWidth) - BRUSH_SIZE / 2;
+            int paintY = static_cast<int>((1.0 - cursorY / height) * worldHeight) - BRUSH_SIZE / 2;
+
+            GLubyte paintValue = 0;
+            if (paintLeft) {
+                bool emitter = glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS;
+                paintValue = (emitter ? EMITTER_MASK : WALL_MASK) | 0x4;  //material index 1, like GenerateSceneBitmap.comp
             }
-            
-            //-----------------------------Sample Probes and write to screen------------------------
-            glUseProgram(screenWrite.id());
-            glBindVertexArray(quadVAO);
-            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-            glBindVertexArray(0);
+
+            bool moved = paintX != lastPaintX || paintY != lastPaintY || paintValue != lastPaintValue;
+            if (moved)
+                cascades.paint(paintX, paintY, BRUSH_SIZE, BRUSH_SIZE, paintValue);
+            lastPaintX = paintX;
+            lastPaintY = paintY;
+            lastPaintValue = paintValue;
+        }
+        else {
+            lastPaintX = lastPaintY = -1;
+        }
+
+        //SPACE relights everything, edits only relight the texels they affect once there's a full relight to build on.
+        //with render on demand, settings that change the cascades relight on their own
+        if (glfwGetKey(window, GLFW_KEY_SPACE) || (renderOnDemand && !cascades.upToDate())) {
+            cascades.relight();
+            screenDirty = true;
+            TracyPlot("rays/s", cascades.raysPerSecond());  //profiler average, lags a few relights behind
         }
-        
+        else if (cascades.hasEdits()) {
+            cascades.relightEdits();
+            screenDirty = true;
+        }
+
+        //-----------------------------Sample Probes and write to screen----------------------------
+        bool present = !renderOnDemand || windowNeedsRefresh;
+        if (screenDirty) {
+            glBindFramebuffer(GL_FRAMEBUFFER, screenCacheFBO);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            cascades.screenWrite();
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            screenDirty = false;
+            present = true;
+        }
+
+        if (present) {
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, screenCacheFBO);
+            glBlitFramebuffer(0, 0, cacheWidth, cacheHeight, 0, 0, cacheWidth, cacheHeight, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+            // Swap buffers, display the image and prepare for next frame
+            glfwSwapBuffers(window);
+            windowNeedsRefresh = false;
+        }
+        FrameMark;
+        TracyGpuCollect;
         util::displayFPS(window);
-        // Swap buffers, display the image and prepare for next frame
-        glfwSwapBuffers(window);
-        // Poll events (read keyboard and mouse input)
-        glfwPollEvents();
+
+        //idle frames sleep until there's input, unless a key is held to relight continuously
+        bool busy = present || glfwGetKey(window, GLFW_KEY_SPACE);
+        if (renderOnDemand && !busy)
+            glfwWaitEventsTimeout(IDLE_WAIT_TIME);
+        else
+            glfwPollEvents(); // Poll events (read keyboard and mouse input)
         // Exit if the ESC key is pressed (and also if the window is closed)
         if (glfwGetKey(window, GLFW_KEY_ESCAPE)) {
             glfwSetWindowShouldClose(window, GL_TRUE);
@@ -340,92 +260,141 @@ int main(int, char*[]) {
 
         //-------------------------------DEBUG CONTROLS---------------------------------------------
         if(timePaused != 0) {
-            if(timePaused >= inputPauseTime) {
+            if(glfwGetTime() - timePaused >= inputPauseTime) {
                 timePaused = 0;
             }
-            else timePaused++;
         }
         else {
             if (glfwGetKey(window, GLFW_KEY_I)) {   //interpolation on/off
-                glUseProgram(screenWrite.id());
-                glUniform1i(swInterpLoc, static_cast<int>(interpolate));
-                interpolate = !interpolate;
-                timePaused++;
+                settings.interpolate = !settings.interpolate;
+                screenDirty = true;
+                timePaused = glfwGetTime();
             }
             if (glfwGetKey(window, GLFW_KEY_U)) {   //UV-map of cascade
-                glUseProgram(screenWrite.id());
-                glUniform1i(swUVLoc, static_cast<int>(probeUV));
-                probeUV = !probeUV;
-                timePaused++;
+                settings.probeUV = !settings.probeUV;
+                screenDirty = true;
+                timePaused = glfwGetTime();
             }
             if (glfwGetKey(window, GLFW_KEY_M)) {   //merge on/off
-                glUseProgram(merge.id());
-                glUniform1i(mergeLoc, static_cast<int>(applyMerge));
-                applyMerge = !applyMerge;
-                timePaused++;
+                settings.merge = !settings.merge;
+                timePaused = glfwGetTime();
             }
-            if (glfwGetKey(window, GLFW_KEY_0)) {   //view singular specific cascade 0-6
-                glUseProgram(screenWrite.id());
-                glUniform1i(swLayerLoc, 0);
-                timePaused++;
-                inputPauseTime = defaultInputPauseTime;
+            if (glfwGetKey(window, GLFW_KEY_E)) {   //empty space skipping on/off
+                settings.skipEmptySpace = !settings.skipEmptySpace;
+                std::cout << "empty space skipping: " << (settings.skipEmptySpace ? "on" : "off") << "\n";
+                timePaused = glfwGetTime();
             }
-            if (glfwGetKey(window, GLFW_KEY_1)) {
-                glUseProgram(screenWrite.id());
-                glUniform1i(swLayerLoc, 1);
-                timePaused++;
-                inputPauseTime = defaultInputPauseTime;
+            if (glfwGetKey(window, GLFW_KEY_T)) {   //sphere trace the distance field instead of the DDA
+                settings.sphereTrace = !settings.sphereTrace;
+                std::cout << "sphere tracing: " << (settings.sphereTrace ? "on" : "off") << "\n";
+                timePaused = glfwGetTime();
             }
-            if (glfwGetKey(window, GLFW_KEY_2)) {
-                glUseProgram(screenWrite.id());
-                glUniform1i(swLayerLoc, 2);
-                timePaused++;
-                inputPauseTime = defaultInputPauseTime;
+            if (glfwGetKey(window, GLFW_KEY_G)) {   //cycle the gather: per level, one dispatch, persistent groups
+                static const char* GATHER_MODE_NAMES[] = {"per level", "single dispatch", "persistent"};
+                const int mode = (static_cast<int>(settings.gatherMode) + 1) % 3;
+                settings.gatherMode = static_cast<GpuCascades::GatherMode>(mode);
+                std::cout << "gather: " << GATHER_MODE_NAMES[mode] << "\n";
+                timePaused = glfwGetTime();
             }
-            if (glfwGetKey(window, GLFW_KEY_3)) {
-                glUseProgram(screenWrite.id());
-                glUniform1i(swLayerLoc, 3);
-                timePaused++;
-                inputPauseTime = defaultInputPauseTime;
+            if (glfwGetKey(window, GLFW_KEY_B)) {   //shared memory bitmap tiles for the low levels on/off
+                settings.bitmapTileLevels = settings.bitmapTileLevels > 0 ? 0 : CASCADE_TILED_LEVELS;
+                std::cout << "bitmap tiles: " << (settings.bitmapTileLevels > 0 ? "on" : "off") << "\n";
+                timePaused = glfwGetTime();
             }
-            if (glfwGetKey(window, GLFW_KEY_4)) {
-                glUseProgram(screenWrite.id());
-                glUniform1i(swLayerLoc, 4);
-                timePaused++;
-                inputPauseTime = defaultInputPauseTime;
+            if (glfwGetKey(window, GLFW_KEY_R)) {   //split long rays into pieces on/off
+                settings.splitRays = !settings.splitRays;
+                std::cout << "split rays: " << (settings.splitRays ? "on" : "off") << "\n";
+                timePaused = glfwGetTime();
             }
-            if (glfwGetKey(window, GLFW_KEY_5)) {
-                glUseProgram(screenWrite.id());
-                glUniform1i(swLayerLoc, 5);
-                timePaused++;
-                inputPauseTime = defaultInputPauseTime;
+            if (glfwGetKey(window, GLFW_KEY_D)) {   //merge from direction blocks on/off
+                settings.directionBlocks = !settings.directionBlocks;
+                std::cout << "direction blocks: " << (settings.directionBlocks ? "on" : "off") << "\n";
+                timePaused = glfwGetTime();
             }
-            if (glfwGetKey(window, GLFW_KEY_6)) {
-                glUseProgram(screenWrite.id());
-                glUniform1i(swLayerLoc, 6);
-                timePaused++;
-                inputPauseTime = defaultInputPauseTime;
+            if (glfwGetKey(window, GLFW_KEY_F)) {   //cycle the cascade storage format, empties the cascades
+                const int format = (static_cast<int>(cascades.storageFormat()) + 1) % GpuCascades::STORAGE_FORMAT_COUNT;
+                cascades.setStorageFormat(static_cast<GpuCascades::StorageFormat>(format));
+                std::cout << "storage format: " << GpuCascades::storageFormatName(cascades.storageFormat()) << "\n";
+                screenDirty = true;
+                timePaused = glfwGetTime();
+            }
+            if (glfwGetKey(window, GLFW_KEY_L)) {   //two layer ping-pong storage on/off, the other layers only show interpolated
+                cascades.setPingPongStorage(!cascades.pingPongStorage());
+                std::cout << "ping-pong storage: " << (cascades.pingPongStorage() ? "on" : "off") << "\n";
+                screenDirty = true;
+                timePaused = glfwGetTime();
+            }
+            if (glfwGetKey(window, GLFW_KEY_K)) {   //direction major cascade storage on/off, empties the cascades
+                cascades.setDirectionMajorStorage(!cascades.directionMajorStorage());
+                std::cout << "direction major storage: " << (cascades.directionMajorStorage() ? "on" : "off") << "\n";
+                screenDirty = true;
+                timePaused = glfwGetTime();
+            }
+            if (glfwGetKey(window, GLFW_KEY_H)) {   //cycle the probe scale 1, 2, 4, the probes that many times as far apart, empties the cascades
+                cascades.setProbeScale(cascades.probeScale() == 4 ? 1 : cascades.probeScale() * 2);
+                std::cout << "probe scale: " << cascades.probeScale() << "\n";
+                screenDirty = true;
+                timePaused = glfwGetTime();
+            }
+            if (glfwGetKey(window, GLFW_KEY_N)) {   //edge aware upsampling of the probes on/off, see BiCubicInterpolation.comp
+                settings.upsample = !settings.upsample;
+                std::cout << "upsample: " << (settings.upsample ? "on" : "off") << "\n";
+                screenDirty = true;
+                timePaused = glfwGetTime();
+            }
+            if (glfwGetKey(window, GLFW_KEY_J)) {   //cycle the lowest gathered level 0-2, a probe per 2, 4 or 8 cells
+                settings.lowestLevel = (settings.lowestLevel + 1) % 3;
+                std::cout << "lowest level: " << settings.lowestLevel << "\n";
+                timePaused = glfwGetTime();
+            }
+            if (glfwGetKey(window, GLFW_KEY_O)) {   //render on demand on/off
+                renderOnDemand = !renderOnDemand;
+                std::cout << "render on demand: " << (renderOnDemand ? "on" : "off") << "\n";
+                timePaused = glfwGetTime();
+            }
+            if (glfwGetKey(window, GLFW_KEY_F5)) {  //time the work group sizes again, see WorkGroupTuner.hpp
+                cascades.tuneWorkGroups(true);
+                timePaused = glfwGetTime();
+            }
+            if (glfwGetKey(window, GLFW_KEY_P)) {   //print the average GPU time of every pass
+                profiler.print(std::cout);
+                timePaused = glfwGetTime();
+            }
+            if (glfwGetKey(window, GLFW_KEY_C)) {   //gather once, print the time and the loop iterations per level
+                //timed without counting, the atomics would be part of the time otherwise
+                GLuint64 gatherNs = cascades.timeGather();
+                std::vector<double> steps = cascades.countSteps();
+
+                std::cout << (settings.sphereTrace ? "sphere tracing" : settings.skipEmptySpace ? "DDA + empty space skipping" : "DDA")
+                          << ", gather: " << static_cast<double>(gatherNs) / 1e6 << " ms\n";
+                for(int i = 0; i < CASCADE_COUNT; i++) {
+                    std::cout << "  c" << i << ": " << steps[i] << " steps/ray\n";
+                    TracyPlot(STEP_PLOTS[i], steps[i]);
+                }
+                timePaused = glfwGetTime();
+            }
+            for(int layer = 0; layer <= 6; layer++) {
+                if (glfwGetKey(window, GLFW_KEY_0 + layer)) {   //view singular specific cascade 0-6
+                    settings.screenLayer = layer;
+                    screenDirty = true;
+                    timePaused = glfwGetTime();
+                    inputPauseTime = defaultInputPauseTime;
+                }
             }
             if(glfwGetKey(window, GLFW_KEY_F1)) {   //view combined layers 0-X, X increases/decreases with F1 & F2
-                if(highestLayer > 0)
-                    highestLayer--;
-                timePaused++;
+                if(settings.highestLayer > 0)
+                    settings.highestLayer--;
+                timePaused = glfwGetTime();
                 inputPauseTime = defaultInputPauseTime;
             }
             if(glfwGetKey(window, GLFW_KEY_F2)) {
-                if(highestLayer < 6)
-                    highestLayer++;
-                timePaused++;
+                if(settings.highestLayer < 6)
+                    settings.highestLayer++;
+                timePaused = glfwGetTime();
                 inputPauseTime = defaultInputPauseTime;
             }
         }
-        if(oldRLM != rayLengthMultiplier) {             //lengthen rays with scrollwheel
-            oldRLM = rayLengthMultiplier;
-            for(int i = 0; i < CASCADE_COUNT; i++) {
-                glUseProgram(cascades[i].id());
-                glUniform1i(rayLMLoc[i], rayLengthMultiplier);
-            }
-        }
+        settings.rayLengthMultiplier = rayLengthMultiplier;  //lengthen rays with scrollwheel
     }
 
     // Close the OpenGL window and terminate GLFW
@@ -0,0 +1,943 @@
+#include "GpuCascades.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <string>
+#include <utility>
+
+#include "CascadePreprocessor.hpp"
+#include "Profiling.hpp"
+
+namespace {
+
+//local side of the Cascade.comp variants that don't get tuned, see WorkGroupTuner.hpp
+constexpr int GATHER_GROUP_SIDE = 16;
+//groups of the persistent gather, a few per core of a big GPU. each invocation takes at most
+//PERSISTENT_BATCH_SLACK times its even share of the ray batches (RAY_BATCH in Cascade.comp), so the
+//dispatch also ends where the groups run one after another, like on llvmpipe
+constexpr GLuint PERSISTENT_GATHER_GROUPS = 512;
+constexpr int PERSISTENT_INVOCATIONS = PERSISTENT_GATHER_GROUPS * 16 * 16;
+constexpr int PERSISTENT_RAY_BATCH = 4;
+constexpr int PERSISTENT_BATCH_SLACK = 4;
+constexpr int FUSED_MERGE_TILE_SIDE = 16;  //TILE_SIDE in FusedMerge.comp
+//tile rows of the merge progress buffer per layer, TILE_ROWS in FusedMerge.comp at probe scale 1
+constexpr GLuint FUSED_MERGE_MAX_TILE_ROWS = CASCADE_TEXTURE_SIDE / FUSED_MERGE_TILE_SIDE;
+constexpr int PING_PONG_LAYERS = 2;  //CASCADE_PING_PONG in CascadeStorage.glsl
+
+//the texture of each GpuCascades::StorageFormat, in order, and its CascadeStorage.glsl define
+struct StorageInfo {
+    GLenum internalFormat;
+    const char* define;
+};
+constexpr StorageInfo STORAGE_INFOS[] = {
+    {GL_RGBA16F, "CASCADE_RGBA16F"},
+    {GL_R11F_G11F_B10F, "CASCADE_R11F_G11F_B10F"},
+    {GL_R32UI, "CASCADE_RGB9E5"},  //packed by hand, RGB9_E5 can't be an image
+    {GL_R32UI, "CASCADE_PACKED32"},
+};
+
+//CPU side of UnpackRgb9e5() in CascadeStorage.glsl, into rgba with a = 0
+void unpackRgb9e5(GLuint word, float* rgba) {
+    const int exponent = static_cast<int>(word >> 27) - 24;
+    for (int c = 0; c < 3; c++) {
+        rgba[c] = std::ldexp(static_cast<float>((word >> (9 * c)) & 511u), exponent);
+    }
+    rgba[3] = 0.f;
+}
+
+//CPU side of UnpackPacked32(): each 10 bits are the top of a positive half
+void unpackPacked32(GLuint word, float* rgba) {
+    for (int c = 0; c < 3; c++) {
+        const GLuint bits = (word >> (10 * c)) & 0x3FFu;
+        const int exponent = static_cast<int>(bits >> 5);
+        const float mantissa = static_cast<float>(bits & 31u);
+        rgba[c] = exponent == 0 ? std::ldexp(mantissa, -19)  //subnormal: m / 32 * 2^-14
+                                : std::ldexp(32.f + mantissa, exponent - 20);
+    }
+    rgba[3] = static_cast<float>(word >> 31);
+}
+
+//this bitmap is the scene. it contains the wall/emissive data that the rays march against.
+GLuint createBitmap(int width, int height) {
+    GLuint bitmap;
+    glGenTextures(1, &bitmap);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, bitmap);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_R8UI, width, height);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    glBindImageTexture(0, bitmap, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R8UI);  //image unit 0
+    GLuint zero = 0;
+    glClearTexImage(bitmap, 0, GL_RED_INTEGER, GL_UNSIGNED_BYTE, &zero);
+    return bitmap;
+}
+
+//Tracy zones, one per layer
+const ProfileSite GATHER_ZONES[CASCADE_LAYER_COUNT] = {
+    PROFILE_SITE("gather c0", "GpuCascades::gatherLevel"),
+    PROFILE_SITE("gather c1", "GpuCascades::gatherLevel"),
+    PROFILE_SITE("gather c2", "GpuCascades::gatherLevel"),
+    PROFILE_SITE("gather c3", "GpuCascades::gatherLevel"),
+    PROFILE_SITE("gather c4", "GpuCascades::gatherLevel"),
+    PROFILE_SITE("gather c5", "GpuCascades::gatherLevel"),
+    PROFILE_SITE("gather c6", "GpuCascades::gatherLevel"),
+};
+const ProfileSite MERGE_ZONES[CASCADE_LAYER_COUNT] = {
+    PROFILE_SITE("merge c0", "GpuCascades::mergeLayer"),  //unused, layer 0 has nothing below
+    PROFILE_SITE("merge c1", "GpuCascades::mergeLayer"),
+    PROFILE_SITE("merge c2", "GpuCascades::mergeLayer"),
+    PROFILE_SITE("merge c3", "GpuCascades::mergeLayer"),
+    PROFILE_SITE("merge c4", "GpuCascades::mergeLayer"),
+    PROFILE_SITE("merge c5", "GpuCascades::mergeLayer"),
+    PROFILE_SITE("merge c6", "GpuCascades::mergeLayer"),
+};
+
+}  // namespace
+
+GpuCascades::GpuCascades(const std::string& sceneFile, int cascadeCount)
+    : cascadeCount_(std::clamp(cascadeCount, 1, CASCADE_LAYER_COUNT))
+    , sceneTexture_(sceneFile)
+    , bitmap_(createBitmap(WORLD_WIDTH, WORLD_HEIGHT))
+    , occupancyPyramid_(bitmap_, WORLD_WIDTH, WORLD_HEIGHT)
+    , jumpFlood_(bitmap_, WORLD_WIDTH, WORLD_HEIGHT)
+    , dirtyProbes_(WORLD_WIDTH, WORLD_HEIGHT) {
+    //profiler pass names, built once so the dispatches don't make strings
+    for (int i = 0; i < CASCADE_LAYER_COUNT; i++) {
+        for (int dirty = 0; dirty < 2; dirty++) {
+            const std::string suffix = std::to_string(i) + (dirty ? ".dirty" : "");
+            gatherPasses_[dirty][i] = "gather.c" + suffix;
+            mergePasses_[dirty][i] = "merge.c" + suffix;
+        }
+        fluencePasses_[i] = "fluence.c" + std::to_string(i);
+    }
+    gatherAllPasses_[0] = "gather.all";
+    gatherAllPasses_[1] = "gather.all.dirty";
+    persistentPasses_[0] = "gather.persistent";
+    persistentPasses_[1] = "gather.persistent.dirty";
+    fusedPasses_[0] = "merge.fused";
+    fusedPasses_[1] = "merge.fused.dirty";
+
+    bitmapGenerator_.createComputeShader("shaders/GenerateSceneBitmap.comp",
+                                         WorkGroupTuner::defines(bitmapGroup_));
+    generateBitmap();
+    //max mip chain of the bitmap, lets the rays jump over empty blocks
+    occupancyPyramid_.build();
+    //distance to the closest wall or emitter, for sphere tracing the rays
+    jumpFlood_.build();
+
+    //mats are not implemented yet.
+    //emissive material atlas. Each texel has a color and a brightness, that's all that materials
+    //contain for now.
+    constexpr int atlasSide = 8;
+    std::vector<float> atlasData(atlasSide * atlasSide * 4);
+    for (size_t i = 0; i < atlasData.size(); i += 4) {
+        atlasData[i + 1] = 1.f;
+        atlasData[i + 3] = 1.f;
+    }
+    std::fill(atlasData.begin(), atlasData.begin() + 4, 0.f);
+
+    glGenTextures(1, &materialAtlas_);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, materialAtlas_);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA32F, atlasSide, atlasSide);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, atlasSide, atlasSide, GL_RGBA, GL_FLOAT,
+                    atlasData.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    glGenBuffers(1, &blockedBits_);
+
+    //the cascades on TU 5 are sampled with linear filtering, for the direction major merge
+    glGenSamplers(1, &cascadeFilter_);
+    glSamplerParameteri(cascadeFilter_, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glSamplerParameteri(cascadeFilter_, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glSamplerParameteri(cascadeFilter_, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glSamplerParameteri(cascadeFilter_, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindSampler(5, cascadeFilter_);
+
+    //a texel per cell, the light upsample() rebuilds from the probes
+    glGenTextures(1, &upsampled_);
+    glActiveTexture(GL_TEXTURE7);
+    glBindTexture(GL_TEXTURE_2D, upsampled_);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA16F, WORLD_WIDTH, WORLD_HEIGHT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    upsample_.createComputeShader("shaders/BiCubicInterpolation.comp");
+    upsampleLevelLoc_ = glGetUniformLocation(upsample_.id(), "_Level");
+
+    //loop iterations of all rays per level, filled when _CountSteps is set
+    glGenBuffers(1, &stepCounts_);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, stepCounts_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, CASCADE_LAYER_COUNT * sizeof(GLuint), nullptr,
+                 GL_DYNAMIC_READ);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, stepCounts_);
+
+    //ticket counter + finished tiles per tile row of each layer, for FusedMerge.comp
+    glGenBuffers(1, &mergeProgress_);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mergeProgress_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER,
+                 (1 + CASCADE_LAYER_COUNT * FUSED_MERGE_MAX_TILE_ROWS) * sizeof(GLuint), nullptr,
+                 GL_DYNAMIC_COPY);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, mergeProgress_);
+
+    //next ray to hand out, for CascadePersistent.comp
+    glGenBuffers(1, &rayQueue_);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, rayQueue_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint), nullptr, GL_DYNAMIC_COPY);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, rayQueue_);
+
+    glGenQueries(2, gatherTimers_);
+
+    //rebind bitmap to TU 0 for sampling. this shouldn't be necessary as bindings are global,
+    //but had issues where the binding got lost and the scenetexture was read instead.
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, bitmap_);
+
+    //one shader per level, so the DDA loops get unrolled with a compile-time CASCADE_LEVEL
+    CascadePreprocessor::preprocessCascades(cascadeCount_);
+    //the cascades and every shader that uses them
+    createCascadeStorage();
+
+    //quad for writing to screen:
+    constexpr float quadVertices[] = {
+        -1.f, -1.f,    0.f, 0.f,
+         1.f, -1.f,    1.f, 0.f,
+        -1.f,  1.f,    0.f, 1.f,
+         1.f,  1.f,    1.f, 1.f,
+    };
+    glGenVertexArrays(1, &quadVAO_);
+    glGenBuffers(1, &quadVBO_);
+    glBindVertexArray(quadVAO_);
+    glBindBuffer(GL_ARRAY_BUFFER, quadVBO_);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);  //position
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), nullptr);
+    glEnableVertexAttribArray(1);  //texcoords
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float),
+                          reinterpret_cast<void*>(2 * sizeof(float)));
+    glBindVertexArray(0);
+
+    //local sizes for this driver, timed on the first run and cached after
+    tuneWorkGroups();
+}
+
+GpuCascades::~GpuCascades() {
+    glDeleteVertexArrays(1, &quadVAO_);
+    glDeleteBuffers(1, &quadVBO_);
+    glDeleteQueries(2, gatherTimers_);
+    glDeleteBuffers(1, &mergeProgress_);
+    glDeleteBuffers(1, &rayQueue_);
+    glDeleteBuffers(1, &stepCounts_);
+    glDeleteBuffers(1, &blockedBits_);
+    glDeleteSamplers(1, &cascadeFilter_);
+    glDeleteTextures(1, &directionBlocks_);
+    glDeleteTextures(1, &upsampled_);
+    glDeleteTextures(1, &fluence_);
+    glDeleteTextures(1, &cascades_);
+    glDeleteTextures(1, &materialAtlas_);
+    glDeleteTextures(1, &bitmap_);
+}
+
+void GpuCascades::generateBitmap() {
+    TracyGpuZone("bitmap");
+    glActiveTexture(GL_TEXTURE10);
+    glBindTexture(GL_TEXTURE_2D, sceneTexture_.id());
+    glBindImageTexture(0, bitmap_, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R8UI);
+
+    glUseProgram(bitmapGenerator_.id());
+    glDispatchCompute(static_cast<GLuint>(WORLD_WIDTH / bitmapGroup_.x),
+                      static_cast<GLuint>(WORLD_HEIGHT / bitmapGroup_.y), 1);
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT |
+                    GL_TEXTURE_UPDATE_BARRIER_BIT);
+
+    dirtyProbes_.clear();  //edits are gone, the whole scene changed
+    relit_ = false;
+}
+
+const char* GpuCascades::storageFormatName(StorageFormat format) {
+    switch (format) {
+    case StorageFormat::R11fG11fB10f: return "r11f_g11f_b10f";
+    case StorageFormat::Rgb9e5: return "rgb9e5";
+    case StorageFormat::Packed32: return "packed32";
+    default: return "rgba16f";
+    }
+}
+
+bool GpuCascades::storageFormatFromName(const std::string& name, StorageFormat& format) {
+    for (int i = 0; i < STORAGE_FORMAT_COUNT; i++) {
+        if (name == storageFormatName(static_cast<StorageFormat>(i))) {
+            format = static_cast<StorageFormat>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+void GpuCascades::setStorageFormat(StorageFormat format) {
+    if (format == storageFormat_) return;
+    storageFormat_ = format;
+    createCascadeStorage();
+    relit_ = false;
+}
+
+void GpuCascades::setPingPongStorage(bool pingPong) {
+    if (pingPong == pingPong_) return;
+    pingPong_ = pingPong;
+    createCascadeStorage();
+    relit_ = false;
+}
+
+void GpuCascades::setDirectionMajorStorage(bool directionMajor) {
+    if (directionMajor == directionMajor_) return;
+    directionMajor_ = directionMajor;
+    createCascadeStorage();
+    relit_ = false;
+}
+
+void GpuCascades::setProbeScale(int scale) {
+    scale = scale >= 4 ? 4 : scale >= 2 ? 2 : 1;
+    if (scale == probeScale_) return;
+    probeScale_ = scale;
+    createCascadeStorage();
+    relit_ = false;
+}
+
+void GpuCascades::createCascadeStorage() {
+    const StorageInfo& info = STORAGE_INFOS[static_cast<int>(storageFormat_)];
+    storageDefines_ = std::string("#define ") + info.define + "\n" +
+                      (pingPong_ ? "#define CASCADE_PING_PONG\n" : "") +
+                      (directionMajor_ ? "#define CASCADE_DIRECTION_MAJOR\n" : "") +
+                      (probeScale_ > 1 ? "#define CASCADE_PROBE_SCALE " +
+                                             std::to_string(probeScale_) + "\n"
+                                       : std::string()) +
+                      readFile("shaders/CascadeStorage.glsl");
+    const int layers = pingPong_ ? PING_PONG_LAYERS : CASCADE_LAYER_COUNT;
+    const int side = layerSide();
+
+    //immutable storage, a new format is a new texture
+    glDeleteTextures(1, &cascades_);
+    glGenTextures(1, &cascades_);
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, cascades_);
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, info.internalFormat, side, side, layers);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    //FusedMerge.comp reads it
+    glBindImageTexture(2, cascades_, 0, GL_TRUE, 0, GL_READ_WRITE, info.internalFormat);
+    //and LoadRadianceFiltered() through cascadeFilter_
+    glActiveTexture(GL_TEXTURE5);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, cascades_);
+
+    //gotBlocked of every texel when the format has no room for it, see CascadeStorage.glsl
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, blockedBits_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, blockedBitsLayerWords() * layers * sizeof(GLuint),
+                 nullptr, GL_DYNAMIC_COPY);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, blockedBits_);
+
+    //a texel per probe, mip N for layer N. the layers that aren't built stay dark
+    glDeleteTextures(1, &fluence_);
+    glGenTextures(1, &fluence_);
+    glActiveTexture(GL_TEXTURE4);
+    glBindTexture(GL_TEXTURE_2D, fluence_);
+    glTexStorage2D(GL_TEXTURE_2D, CASCADE_LAYER_COUNT, GL_RGBA16F, side / 2, side / 2);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    const float black[4] = {};
+    for (int level = 0; level < CASCADE_LAYER_COUNT; level++) {
+        glClearTexImage(fluence_, level, GL_RGBA, GL_FLOAT, black);
+    }
+
+    //as many layers as the cascades, allocated again by the next merge that uses them
+    glDeleteTextures(1, &directionBlocks_);
+    directionBlocks_ = 0;
+
+    //the bitmap back on TU 0, see the constructor
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, bitmap_);
+
+    //the tuned local sizes for the per level shaders, CascadeAll.comp in the ALL_LEVELS slot, the
+    //split levels after it and CascadePersistent.comp last
+    for (int i = 0; i < cascadeCount_; i++) {
+        createGatherShader(i, "Cascade" + std::to_string(i),
+                           WorkGroupTuner::defines(gatherGroups_[i]));
+        if (cascadeRaySegments(i) > 1) {
+            createGatherShader(SPLIT_LEVELS + i, "CascadeSplit" + std::to_string(i));
+        }
+    }
+    createGatherShader(ALL_LEVELS, "CascadeAll");
+    createGatherShader(PERSISTENT, "CascadePersistent");
+    maxBatchesLoc_ = glGetUniformLocation(gather_[PERSISTENT].id(), "_MaxBatches");
+
+    createMergeShader();
+    createFusedMergeShader();
+    createFluenceShader();
+    createScreenWriteShader();
+}
+
+void GpuCascades::createGatherShader(int slot, const std::string& file, const std::string& defines) {
+    gather_[slot].createComputeShader("shaders/generated/" + file + ".comp",
+                                      defines + storageDefines_);
+    const GLuint program = gather_[slot].id();
+    glUseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "_bitmapTexture"), 0);
+    rayLengthMultiplierLoc_[slot] = glGetUniformLocation(program, "_RayLengthMultiplier");
+    skipEmptySpaceLoc_[slot] = glGetUniformLocation(program, "_SkipEmptySpace");
+    sphereTraceLoc_[slot] = glGetUniformLocation(program, "_SphereTrace");
+    countStepsLoc_[slot] = glGetUniformLocation(program, "_CountSteps");
+    dirtyOnlyLoc_[slot] = glGetUniformLocation(program, "_DirtyOnly");
+    bitmapTileLoc_[slot] = glGetUniformLocation(program, "_BitmapTile");
+    glUniform1i(countStepsLoc_[slot], 0);
+}
+
+void GpuCascades::createMergeShader() {
+    merge_.createComputeShader("shaders/MergeCascades.comp",
+                               WorkGroupTuner::defines(mergeGroup_) + storageDefines_);
+    mergeLoc_ = glGetUniformLocation(merge_.id(), "_Merge");
+    sourceLayerLoc_ = glGetUniformLocation(merge_.id(), "_sourceLayerIndex");
+    mergeDirtyOnlyLoc_ = glGetUniformLocation(merge_.id(), "_DirtyOnly");
+    mergeDirectionBlocksLoc_ = glGetUniformLocation(merge_.id(), "_DirectionBlocks");
+    sourceBlocksLoc_ = glGetUniformLocation(merge_.id(), "_SourceBlocks");
+}
+
+void GpuCascades::createFusedMergeShader() {
+    //the tiles of the layer above are written by other groups of the same dispatch
+    fusedMerge_.createComputeShader("shaders/FusedMerge.comp",
+                                    "#define CASCADE_COHERENT coherent\n" + storageDefines_);
+    fusedHighestLayerLoc_ = glGetUniformLocation(fusedMerge_.id(), "_HighestLayer");
+    fusedMergeLoc_ = glGetUniformLocation(fusedMerge_.id(), "_Merge");
+    fusedDirtyOnlyLoc_ = glGetUniformLocation(fusedMerge_.id(), "_DirtyOnly");
+    fusedDirectionBlocksLoc_ = glGetUniformLocation(fusedMerge_.id(), "_DirectionBlocks");
+    fusedLowest_.createComputeShader("shaders/FusedMerge.comp", "#define FUSED_MERGE_LOWEST\n"
+                                    "#define CASCADE_COHERENT coherent\n" + storageDefines_);
+    lowestHighestLayerLoc_ = glGetUniformLocation(fusedLowest_.id(), "_HighestLayer");
+    lowestDirtyOnlyLoc_ = glGetUniformLocation(fusedLowest_.id(), "_DirtyOnly");
+    lowestDirectionBlocksLoc_ = glGetUniformLocation(fusedLowest_.id(), "_DirectionBlocks");
+}
+
+void GpuCascades::createFluenceShader() {
+    reduceFluence_.createComputeShader("shaders/ReduceFluence.comp", storageDefines_);
+    fluenceLevelLoc_ = glGetUniformLocation(reduceFluence_.id(), "_Level");
+}
+
+void GpuCascades::createScreenWriteShader() {
+    screenWrite_.createShader("shaders/ScreenWrite.vert", "shaders/ScreenWrite.frag",
+                              storageDefines_);
+    layerLoc_ = glGetUniformLocation(screenWrite_.id(), "_Layer");
+    interpolateLoc_ = glGetUniformLocation(screenWrite_.id(), "_Interpolate");
+    upsampleLoc_ = glGetUniformLocation(screenWrite_.id(), "_Upsample");
+    probeUVLoc_ = glGetUniformLocation(screenWrite_.id(), "_ProbeUV");
+}
+
+void GpuCascades::tuneWorkGroups(bool retune) {
+    WorkGroupTuner tuner;
+    bool tuned = false;
+    //the cached size, or the fastest one. then the kernel gets built with it, unless it already is
+    const auto pick = [&](const std::string& kernel, int width, int height, WorkGroupSize& current,
+                          const std::function<void(WorkGroupSize)>& prepare,
+                          const std::function<void()>& run) {
+        WorkGroupSize size;
+        if (retune || !tuner.cached(kernel, size)) {
+            size = tuner.tune(kernel, WorkGroupTuner::candidates(width, height), prepare, run);
+            tuned = true;
+            current = {0, 0};  //the last candidate is built, not the best
+        }
+        if (size.x != current.x || size.y != current.y) prepare(size);
+    };
+
+    for (int i = 0; i < cascadeCount_; i++) {
+        pick("gather.c" + std::to_string(i), layerSide(), layerSide(), gatherGroups_[i],
+             [&](WorkGroupSize size) {
+                 gatherGroups_[i] = size;
+                 createGatherShader(i, "Cascade" + std::to_string(i), WorkGroupTuner::defines(size));
+             },
+             [&] { gatherLevel(i); });
+    }
+    pick("merge", layerSide(), layerSide(), mergeGroup_,
+         [&](WorkGroupSize size) {
+             mergeGroup_ = size;
+             createMergeShader();
+         },
+         [&] { mergeLayer(1); });
+    pick("bitmap", WORLD_WIDTH, WORLD_HEIGHT, bitmapGroup_,
+         [&](WorkGroupSize size) {
+             bitmapGroup_ = size;
+             bitmapGenerator_.createComputeShader("shaders/GenerateSceneBitmap.comp",
+                                                  WorkGroupTuner::defines(size));
+         },
+         [&] { generateBitmap(); });
+
+    if (tuned) tuner.save();
+    relit_ = false;  //the timing runs overwrote the layers
+}
+
+void GpuCascades::uploadGatherSettings(int slot) {
+    glUseProgram(gather_[slot].id());
+    glUniform1i(rayLengthMultiplierLoc_[slot], settings_.rayLengthMultiplier);
+    glUniform1i(skipEmptySpaceLoc_[slot], static_cast<int>(settings_.skipEmptySpace));
+    glUniform1i(sphereTraceLoc_[slot], static_cast<int>(settings_.sphereTrace));
+}
+
+int GpuCascades::gatherSlot(int level) const {
+    return settings_.splitRays && cascadeRaySegments(level) > 1 ? SPLIT_LEVELS + level : level;
+}
+
+int GpuCascades::lowestLevel() const {
+    return std::clamp(settings_.lowestLevel, 0, cascadeCount_ - 1);
+}
+
+bool GpuCascades::fusesLowestSteps() const {
+    //without merge the steps add up the same texel, nothing to keep around
+    const bool readsLayer1 =
+        settings_.keepMergedLayers || (settings_.screenLayer == 1 && !settings_.interpolate);
+    return settings_.fusedMerge && settings_.merge && !pingPong_ && lowestLevel() == 0 &&
+           std::min(settings_.highestLayer, CASCADE_LAYER_COUNT - 1) >= 2 && !readsLayer1;
+}
+
+void GpuCascades::gather(bool dirtyOnly) {
+    if (pingPong_) {
+        gatherMergePingPong();
+        return;
+    }
+    if (settings_.gatherMode == GatherMode::SingleDispatch) {
+        gatherAll(dirtyOnly);
+        return;
+    }
+    if (settings_.gatherMode == GatherMode::Persistent) {
+        gatherPersistent(dirtyOnly);
+        return;
+    }
+    for (int i = lowestLevel(); i < cascadeCount_; i++) {
+        gatherLevel(i, dirtyOnly);
+    }
+}
+
+void GpuCascades::gatherMergePingPong() {
+    //levels above the merged ones don't reach layer 0, and levels that aren't gathered would be
+    //merged from whatever the layer they share holds instead of the unwritten zeros of 7 layers
+    const int lowest = lowestLevel();
+    const int top = std::clamp(std::min(settings_.highestLayer, cascadeCount_ - 1), lowest,
+                               CASCADE_LAYER_COUNT - 1);
+    //each level's fluence while the level is still there, after the merge into it
+    gatherLevel(top);
+    buildFluenceLevel(top);
+    for (int level = top - 1; level >= lowest; level--) {
+        //level shares its layer with level + 2, which the last mergeLayer() and
+        //buildFluenceLevel() read
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT |
+                        GL_SHADER_STORAGE_BARRIER_BIT);
+        gatherLevel(level);
+        mergeLayer(level + 1);
+        buildFluenceLevel(level);
+    }
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);  //for the screen write
+}
+
+void GpuCascades::gatherAll(bool dirtyOnly) {
+    TracyGpuZone("gather all");
+    profiler_.begin(gatherAllPasses_[dirtyOnly]);
+    uploadGatherSettings(ALL_LEVELS);
+    glUniform1i(dirtyOnlyLoc_[ALL_LEVELS], static_cast<int>(dirtyOnly));
+    const GLuint groups = static_cast<GLuint>(layerSide() / GATHER_GROUP_SIDE);
+    glDispatchCompute(groups, groups, static_cast<GLuint>(cascadeCount_));  //z = level
+    profiler_.end();
+}
+
+void GpuCascades::gatherPersistent(bool dirtyOnly) {
+    //the atomics of the last persistent gather before clearing the queue
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    TracyGpuZone("gather persistent");
+    profiler_.begin(persistentPasses_[dirtyOnly]);
+    GLuint zero = 0;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, rayQueue_);
+    glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+
+    uploadGatherSettings(PERSISTENT);
+    glUniform1i(dirtyOnlyLoc_[PERSISTENT], static_cast<int>(dirtyOnly));
+    const int batches = cascadeCount_ * layerSide() * layerSide() / PERSISTENT_RAY_BATCH;
+    const int share = (batches + PERSISTENT_INVOCATIONS - 1) / PERSISTENT_INVOCATIONS;
+    glUniform1i(maxBatchesLoc_, PERSISTENT_BATCH_SLACK * share);
+    glDispatchCompute(PERSISTENT_GATHER_GROUPS, 1, 1);
+    profiler_.end();
+}
+
+void GpuCascades::gatherLevel(int level, bool dirtyOnly) {
+    GpuZoneAt(GATHER_ZONES[level]);
+    profiler_.begin(gatherPasses_[dirtyOnly][level]);
+    const int slot = gatherSlot(level);
+    uploadGatherSettings(slot);
+    glUniform1i(dirtyOnlyLoc_[slot], static_cast<int>(dirtyOnly));
+    glUniform1i(bitmapTileLoc_[slot], static_cast<int>(level < settings_.bitmapTileLevels));
+    if (slot == level) {
+        glDispatchCompute(static_cast<GLuint>(layerSide() / gatherGroups_[level].x),
+                          static_cast<GLuint>(layerSide() / gatherGroups_[level].y), 1);
+    } else {
+        //the split shader has an invocation per piece of a ray, so as many more groups
+        const GLuint groups = static_cast<GLuint>(layerSide() / GATHER_GROUP_SIDE);
+        glDispatchCompute(groups, groups * static_cast<GLuint>(cascadeRaySegments(level)), 1);
+    }
+    profiler_.end();
+}
+
+void GpuCascades::merge(bool dirtyOnly) {
+    if (pingPong_) return;  //gather() merged level by level
+    if (settings_.fusedMerge) {
+        mergeFused(dirtyOnly);
+    } else {
+        for (int i = settings_.highestLayer; i > lowestLevel(); i--) {
+            mergeLayer(i, dirtyOnly);
+        }
+    }
+    buildFluence();
+}
+
+void GpuCascades::mergeLayer(int sourceLayer, bool dirtyOnly) {
+    //reads the layer above through the sampler, and the blocked flags of the layer below
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT |
+                    GL_SHADER_STORAGE_BARRIER_BIT);
+    GpuZoneAt(MERGE_ZONES[sourceLayer]);
+    profiler_.begin(mergePasses_[dirtyOnly][sourceLayer]);
+    glUseProgram(merge_.id());
+    glUniform1i(mergeLoc_, static_cast<int>(settings_.merge));
+    glUniform1i(mergeDirtyOnlyLoc_, static_cast<int>(dirtyOnly));
+    glUniform1i(sourceLayerLoc_, sourceLayer);
+    //the merge into sourceLayer wrote its blocks, unless it's the first merge step
+    const int firstSource = pingPong_ ? std::min(settings_.highestLayer, cascadeCount_ - 1)
+                                      : settings_.highestLayer;
+    const bool directionBlocks = settings_.directionBlocks && !directionMajor_;
+    if (directionBlocks) bindDirectionBlocks();
+    glUniform1i(mergeDirectionBlocksLoc_, static_cast<int>(directionBlocks));
+    glUniform1i(sourceBlocksLoc_, static_cast<int>(directionBlocks && sourceLayer < firstSource));
+    glDispatchCompute(static_cast<GLuint>(layerSide() / mergeGroup_.x),
+                      static_cast<GLuint>(layerSide() / mergeGroup_.y), 1);
+    profiler_.end();
+}
+
+void GpuCascades::mergeFused(bool dirtyOnly) {
+    const int highestLayer = std::clamp(settings_.highestLayer, 0, CASCADE_LAYER_COUNT - 1);
+    const int lowest = lowestLevel();
+    if (highestLayer <= lowest) return;
+
+    //the gathered layers and blocked flags, and the atomics of the last fused merge before
+    //clearing them
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT |
+                    GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+    TracyGpuZone("merge fused");
+    profiler_.begin(fusedPasses_[dirtyOnly]);
+    GLuint zero = 0;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mergeProgress_);
+    glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+
+    glUseProgram(fusedMerge_.id());
+    glUniform1i(fusedHighestLayerLoc_, highestLayer);
+    glUniform1i(fusedMergeLoc_, static_cast<int>(settings_.merge));
+    glUniform1i(fusedDirtyOnlyLoc_, static_cast<int>(dirtyOnly));
+    const bool directionBlocks = settings_.directionBlocks && !directionMajor_;
+    if (directionBlocks) bindDirectionBlocks();
+    glUniform1i(fusedDirectionBlocksLoc_, static_cast<int>(directionBlocks));
+    //one group per tile of every merge step, the tickets decide which. the steps go top down, so
+    //leaving out groups leaves out the lowest steps
+    const bool fuseLowest = fusesLowestSteps();
+    const int steps = highestLayer - lowest - (fuseLowest ? 2 : 0);
+    const GLuint tileRows = static_cast<GLuint>(layerSide() / FUSED_MERGE_TILE_SIDE);
+    if (steps > 0) {
+        glDispatchCompute(tileRows, tileRows * static_cast<GLuint>(steps), 1);
+    }
+
+    if (fuseLowest) {
+        //layer 2 into 1 into 0 a tile at a time, after layer 2 and its blocks are merged
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+        glUseProgram(fusedLowest_.id());
+        glUniform1i(lowestHighestLayerLoc_, highestLayer);
+        glUniform1i(lowestDirtyOnlyLoc_, static_cast<int>(dirtyOnly));
+        glUniform1i(lowestDirectionBlocksLoc_, static_cast<int>(directionBlocks));
+        glBindImageTexture(4, fluence_, 1, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+        glDispatchCompute(tileRows / 2, tileRows / 2, 1);  //2x2 tiles each
+    }
+    profiler_.end();
+}
+
+void GpuCascades::bindDirectionBlocks() {
+    if (directionBlocks_ == 0) {
+        //a texel per 4 neighbouring texels of a row, see CascadeStorage.glsl. never sampled
+        glGenTextures(1, &directionBlocks_);
+        bindScratchUnit();  //TU 5 holds the cascades
+        glBindTexture(GL_TEXTURE_2D_ARRAY, directionBlocks_);
+        const int layers = pingPong_ ? PING_PONG_LAYERS : CASCADE_LAYER_COUNT;
+        glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_RGBA16F, layerSide() / CASCADE_SCALING,
+                       layerSide(), layers);
+        glActiveTexture(GL_TEXTURE0);
+    }
+    //unit 3 is rebound by every OccupancyPyramid build
+    glBindImageTexture(3, directionBlocks_, 0, GL_TRUE, 0, GL_READ_WRITE, GL_RGBA16F);
+}
+
+void GpuCascades::buildFluence() {
+    for (int i = lowestLevel(); i < cascadeCount_; i++) {
+        if (i == 1 && fusesLowestSteps()) continue;  //the merge wrote it, layer 1 isn't merged
+        buildFluenceLevel(i);
+    }
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);  //for the screen write
+}
+
+void GpuCascades::buildFluenceLevel(int level) {
+    //the merged layer, through the sampler
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+    TracyGpuZone("fluence");
+    profiler_.begin(fluencePasses_[level]);
+    glBindImageTexture(4, fluence_, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+    glUseProgram(reduceFluence_.id());
+    glUniform1i(fluenceLevelLoc_, level);
+    //64 invocations per group, as many per probe as it has directions, up to all of them
+    const int side = CASCADE_PROBE_SIDES[level];
+    const int lanes = std::min(side * side, 64);
+    const int probes = (layerSide() / side) * (layerSide() / side);
+    glDispatchCompute(static_cast<GLuint>(probes * lanes / 64), 1, 1);
+    profiler_.end();
+}
+
+void GpuCascades::upsample() {
+    //the fluence, and the bitmap and pyramid of paint()
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+    TracyGpuZone("upsample");
+    profiler_.begin("upsample");
+    glBindImageTexture(4, upsampled_, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+    glUseProgram(upsample_.id());
+    glUniform1i(upsampleLevelLoc_, std::max(settings_.screenLayer, lowestLevel()));
+    glDispatchCompute(WORLD_WIDTH / 16, WORLD_HEIGHT / 16, 1);
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);  //for the screen write
+    profiler_.end();
+}
+
+void GpuCascades::screenWrite() {
+    if (settings_.upsample) upsample();
+    TracyGpuZone("screenWrite");
+    profiler_.begin("screenWrite");
+    glUseProgram(screenWrite_.id());
+    glUniform1i(layerLoc_, std::max(settings_.screenLayer, lowestLevel()));
+    glUniform1i(interpolateLoc_, static_cast<int>(settings_.interpolate));
+    glUniform1i(upsampleLoc_, static_cast<int>(settings_.upsample));
+    glUniform1i(probeUVLoc_, static_cast<int>(settings_.probeUV));
+    glBindVertexArray(quadVAO_);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    glBindVertexArray(0);
+    profiler_.end();
+}
+
+void GpuCascades::relight() {
+    ZoneScoped;
+    gather();
+    merge();
+    dirtyProbes_.clear();
+    relitSettings_ = settings_;
+    relitFusedLowest_ = fusesLowestSteps();
+    relit_ = true;
+}
+
+bool GpuCascades::upToDate() const {
+    //the screen write settings don't change the cascades, unless the texel view of layer 1
+    //changes whether the fused merge writes it
+    return relit_ && settings_.highestLayer == relitSettings_.highestLayer &&
+           settings_.lowestLevel == relitSettings_.lowestLevel &&
+           settings_.rayLengthMultiplier == relitSettings_.rayLengthMultiplier &&
+           settings_.merge == relitSettings_.merge &&
+           settings_.fusedMerge == relitSettings_.fusedMerge &&
+           fusesLowestSteps() == relitFusedLowest_ &&
+           settings_.skipEmptySpace == relitSettings_.skipEmptySpace &&
+           settings_.sphereTrace == relitSettings_.sphereTrace;
+}
+
+void GpuCascades::paint(int x, int y, int w, int h, GLubyte value) {
+    const int x0 = std::max(x, 0);
+    const int y0 = std::max(y, 0);
+    const int x1 = std::min(x + w, WORLD_WIDTH);
+    const int y1 = std::min(y + h, WORLD_HEIGHT);
+    if (x0 >= x1 || y0 >= y1) return;
+    ZoneScoped;
+
+    std::vector<GLubyte> cells(static_cast<size_t>((x1 - x0) * (y1 - y0)), value);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, bitmap_);
+    //rows of a cut rectangle aren't 4 byte aligned
+    GLint alignment;
+    glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, x0, y0, x1 - x0, y1 - y0, GL_RED_INTEGER, GL_UNSIGNED_BYTE,
+                    cells.data());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+
+    occupancyPyramid_.update(x0, y0, x1 - x0, y1 - y0);
+    jumpFlood_.build();  //distances change far away from the edit, no partial update
+    dirtyProbes_.add(x0, y0, x1 - x0, y1 - y0);
+}
+
+void GpuCascades::relightEdits() {
+    ZoneScoped;
+    //two layers don't keep the levels above for merging the dirty texels again
+    if (!upToDate() || pingPong_) {
+        relight();
+        return;
+    }
+
+    dirtyProbes_.clearMask();
+    for (int i = cascadeCount_ - 1; i >= 0; i--) {
+        dirtyProbes_.mark(i, layerSide(), settings_.rayLengthMultiplier,
+                          i + 1 <= settings_.highestLayer, settings_.merge);
+    }
+    gather(true);
+    merge(true);
+    dirtyProbes_.clear();
+}
+
+double GpuCascades::raysPerSecond() const {
+    double milliseconds = 0;
+    if (settings_.gatherMode == GatherMode::SingleDispatch) {
+        milliseconds = profiler_.average(gatherAllPasses_[0]);
+    } else if (settings_.gatherMode == GatherMode::Persistent) {
+        milliseconds = profiler_.average(persistentPasses_[0]);
+    } else {
+        for (int i = 0; i < cascadeCount_; i++) {
+            milliseconds += profiler_.average(gatherPasses_[0][i]);
+        }
+    }
+    //one ray per texel of every gathered layer
+    const double rays = static_cast<double>(cascadeCount_) * layerSide() * layerSide();
+    return milliseconds > 0 ? rays / (milliseconds / 1e3) : 0;
+}
+
+GLuint64 GpuCascades::timeGather() {
+    //timestamps rather than GL_TIME_ELAPSED, like WorkGroupTuner::timeRun()
+    glQueryCounter(gatherTimers_[0], GL_TIMESTAMP);
+    gather();
+    glQueryCounter(gatherTimers_[1], GL_TIMESTAMP);
+    GLuint64 begin = 0, end = 0;
+    glGetQueryObjectui64v(gatherTimers_[0], GL_QUERY_RESULT, &begin);
+    glGetQueryObjectui64v(gatherTimers_[1], GL_QUERY_RESULT, &end);
+
+    relit_ = false;
+    return end - begin;
+}
+
+std::vector<double> GpuCascades::countSteps() {
+    GLuint steps[CASCADE_LAYER_COUNT] = {};
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, stepCounts_);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(steps), steps);
+
+    //a separate run, the atomics would be part of timeGather() otherwise
+    for (int i = 0; i < cascadeCount_; i++) {
+        const int slot = gatherSlot(i);
+        glUseProgram(gather_[slot].id());
+        glUniform1i(countStepsLoc_[slot], 1);
+        gatherLevel(i);
+        glUniform1i(countStepsLoc_[slot], 0);
+    }
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(steps), steps);
+
+    std::vector<double> stepsPerRay(static_cast<size_t>(cascadeCount_));
+    for (int i = 0; i < cascadeCount_; i++) {
+        stepsPerRay[i] = static_cast<double>(steps[i]) /
+                         (static_cast<double>(layerSide()) * layerSide());
+    }
+    relit_ = false;
+    return stepsPerRay;
+}
+
+std::vector<float> GpuCascades::readLayer(int index) const {
+    GLint previous;
+    glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previous);
+    GLuint framebuffer;
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    const int layer = pingPong_ ? index % PING_PONG_LAYERS : index;  //StorageTexel()
+    glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, cascades_, 0, layer);
+
+    glMemoryBarrier(GL_FRAMEBUFFER_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+    const int layerSide = this->layerSide();
+    const size_t TEXELS = static_cast<size_t>(layerSide) * layerSide;
+    std::vector<float> texels(TEXELS * 4);
+    if (STORAGE_INFOS[static_cast<int>(storageFormat_)].internalFormat == GL_R32UI) {
+        std::vector<GLuint> words(TEXELS);
+        glReadPixels(0, 0, layerSide, layerSide, GL_RED_INTEGER,
+                     GL_UNSIGNED_INT, words.data());
+        for (size_t t = 0; t < TEXELS; t++) {
+            if (storageFormat_ == StorageFormat::Rgb9e5) {
+                unpackRgb9e5(words[t], &texels[t * 4]);
+            } else {
+                unpackPacked32(words[t], &texels[t * 4]);
+            }
+        }
+    } else {
+        glReadPixels(0, 0, layerSide, layerSide, GL_RGBA, GL_FLOAT, texels.data());
+    }
+
+    if (storageFormat_ == StorageFormat::R11fG11fB10f || storageFormat_ == StorageFormat::Rgb9e5) {
+        const GLsizeiptr words = blockedBitsLayerWords();
+        std::vector<GLuint> bits(static_cast<size_t>(words));
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, blockedBits_);
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, layer * words * sizeof(GLuint),
+                           words * sizeof(GLuint), bits.data());
+        for (size_t t = 0; t < TEXELS; t++) {
+            texels[t * 4 + 3] = static_cast<float>((bits[t / 32] >> (t % 32)) & 1u);
+        }
+    }
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, static_cast<GLuint>(previous));
+    glDeleteFramebuffers(1, &framebuffer);
+
+    if (directionMajor_) {
+        //back to a block of directions per probe, ProbeMajorTexel() in CascadeStorage.glsl
+        const int side = CASCADE_PROBE_SIDES[index];
+        const int gridSide = layerSide / side;
+        std::vector<float> probeMajor(texels.size());
+        for (int y = 0; y < layerSide; y++) {
+            for (int x = 0; x < layerSide; x++) {
+                const size_t from = static_cast<size_t>(y) * layerSide + x;
+                const size_t to = static_cast<size_t>((y % gridSide) * side + y / gridSide) *
+                                      layerSide +
+                                  (x % gridSide) * side + x / gridSide;
+                std::copy_n(&texels[from * 4], 4, &probeMajor[to * 4]);
+            }
+        }
+        return probeMajor;
+    }
+    return texels;
+}
+
+std::vector<float> GpuCascades::readImage(int width, int height) {
+    GLint previous, viewport[4];
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previous);
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    GLuint target, framebuffer;
+    glGenTextures(1, &target);
+    bindScratchUnit();
+    glBindTexture(GL_TEXTURE_2D, target);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA32F, width, height);
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target, 0);
+
+    glViewport(0, 0, width, height);
+    screenWrite();
+    std::vector<float> pixels(static_cast<size_t>(width) * height * 3);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGB, GL_FLOAT, pixels.data());
+
+    glBindFramebuffer(GL_FRAMEBUFFER, static_cast<GLuint>(previous));
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteTextures(1, &target);
+    return pixels;
+}
+
+void GpuCascades::bindScratchUnit() {
+    glActiveTexture(GL_TEXTURE11);
+}
@@ -0,0 +1,345 @@
+/*
+ * The GL cascade pipeline, shared by the viewer in GLMain.cpp and the headless baker in
+ * HeadlessMain.cpp. Same stages as the CPU version in CpuCascades.hpp.
+ *
+ * gather()      - Cascade.comp, one dispatch per gathered level, all of them in one dispatch of
+ *                 CascadeAll.comp, or a fixed grid of persistent groups pulling rays from a queue
+ *                 in CascadePersistent.comp, see GatherMode. With splitRays the long rays of
+ *                 level 3 and up are marched in ~45 cell pieces by CascadeSplitN.comp, see
+ *                 cascadeRaySegments()
+ * merge()       - FusedMerge.comp, top-down merge into layer 2 in one dispatch and into layer 0
+ *                 in another with layer 1 in shared memory (see fusesLowestSteps()), or
+ *                 MergeCascades.comp once per layer. Then buildFluence()
+ * buildFluence() - ReduceFluence.comp, averages the directions of every probe into the fluence
+ *                 texture: mip N holds a texel per probe of layer N, rgb = the mean radiance
+ * screenWrite() - ScreenWrite.vert/.frag, draws the result into the bound framebuffer
+ *
+ * Usage: create it with a current GL 4.3 context, change settings() and call relight() and
+ * screenWrite(). The settings are uploaded by the stage that uses them, so changes show up on the
+ * next call. paint() edits the scene, relightEdits() then only gathers and merges the texels the
+ * edits affect (see DirtyProbes.hpp).
+ *
+ * Owns every texture the shaders read and binds them on creation: bitmap = texture unit 0 / image
+ * unit 0, material atlas = TU 1, cascades = TU 2 / image unit 2 and TU 5 with linear filtering,
+ * occupancy pyramid = TU 3, direction blocks = image unit 3 during a merge, fluence = TU 4 /
+ * image unit 4 while it's built, distance field = TU 6, upsampled light = TU 7 / image unit 4
+ * while it's built, dirty mask = image unit 1, merge progress = shader storage binding 4, step
+ * counts = shader storage binding 5, ray queue = shader storage binding 6, blocked flags = shader
+ * storage binding 7.
+ *
+ * The cascades are stored in one of the StorageFormats, see setStorageFormat(). The shaders that
+ * read or write them get shaders/CascadeStorage.glsl with the format's define in front.
+ * setPingPongStorage() keeps two layers instead of one per level: gather() then gathers and merges
+ * top down, a level at a time, and only layer 0 and the fluence hold a result afterwards.
+ * setDirectionMajorStorage() moves the texels of each layer into an image per direction.
+ * setProbeScale() spaces the probes of every level further apart, for fewer probes and rays.
+ *
+ * The per level gather, the per layer merge and the bitmap generation run with the local size
+ * that was fastest on this driver, see WorkGroupTuner.hpp. The first run on a driver times them,
+ * later runs read the choice from the cache, tuneWorkGroups(true) times them again.
+ *
+ * profiler() times every gather level, merge step and screen write on the GPU while enabled, as
+ * gather.cN, gather.all or gather.persistent, merge.cN (layer N into N - 1) or merge.fused, and
+ * screenWrite. Edit relights add ".dirty". The same passes are Tracy GPU zones in instrumented
+ * builds, see Profiling.hpp.
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "CascadeConstants.hpp"
+#include "DirtyProbes.hpp"
+#include "GpuProfiler.hpp"
+#include "JumpFlood.hpp"
+#include "OccupancyPyramid.hpp"
+#include "Shader.hpp"
+#include "Texture.hpp"
+#include "WorkGroupTuner.hpp"
+
+class GpuCascades {
+public:
+    static constexpr int WORLD_WIDTH = 1024;   //cells of the scene bitmap
+    static constexpr int WORLD_HEIGHT = 1024;
+
+    enum class GatherMode {
+        PerLevel,        //one dispatch per level
+        SingleDispatch,  //every level in one dispatch of CascadeAll.comp, gatherAll()
+        Persistent,      //CascadePersistent.comp, gatherPersistent()
+    };
+
+    enum class StorageFormat {
+        Rgba16f,        //rgb = radiance, a = gotBlocked, 8 bytes per ray
+        R11fG11fB10f,   //radiance, gotBlocked in a buffer with a bit per ray, 4 bytes + 1 bit
+        Rgb9e5,         //radiance with a shared exponent, gotBlocked in the bit buffer
+        Packed32,       //3 x 10 bit floats + gotBlocked in one uint, 4 bytes
+    };
+    static constexpr int STORAGE_FORMAT_COUNT = 4;
+    static const char* storageFormatName(StorageFormat format);  //"rgba16f", "r11f_g11f_b10f", ..
+    // The format storageFormatName() calls name, false if there is none.
+    static bool storageFormatFromName(const std::string& name, StorageFormat& format);
+
+    struct Settings {
+        int highestLayer = 6;         //merging starts from this layer
+        //levels below this aren't gathered or merged and the screen shows this one, 1 = a probe
+        //per 4 x 4 cells. skips the rays of the per level gather and ping-pong storage only.
+        //the light of the short intervals near the probes is lost and the levels above cost as
+        //much as before, so it's for seeing what the low levels add and takes effect without a
+        //reallocation. setProbeScale() is the cheaper hierarchy that keeps every interval
+        int lowestLevel = 0;
+        int rayLengthMultiplier = 1;  //_RayLengthMultiplier in Cascade.comp
+        bool merge = true;            //_Merge in MergeCascades.comp
+        //merge() in one dispatch of FusedMerge.comp. layer 1 then keeps the gathered rays, only
+        //layer 0 and the fluence hold the merge, see fusesLowestSteps()
+        bool fusedMerge = true;
+        //every merged layer stays in the cascades for readLayer(), the fused merge then writes
+        //layer 1 too. on by itself for the texel view of layer 1 (screenLayer 1, no interpolate)
+        bool keepMergedLayers = false;
+        //the merges write each layer averaged over groups of 4 directions and read those, one
+        //fetch per neighbour probe instead of 4 (_DirectionBlocks in MergeCascades.comp)
+        bool directionBlocks = false;
+        GatherMode gatherMode = GatherMode::PerLevel;  //how gather() dispatches
+        bool splitRays = false;       //gatherLevel() with CascadeSplitN.comp where it exists
+        //levels below this march a shared memory copy of the bitmap (_BitmapTile in Cascade.comp)
+        //with the per level gather, up to CASCADE_TILED_LEVELS. 0 = texture fetches everywhere
+        int bitmapTileLevels = 0;
+        bool skipEmptySpace = true;   //_SkipEmptySpace in Cascade.comp
+        bool sphereTrace = false;     //_SphereTrace in Cascade.comp
+        bool interpolate = true;      //_Interpolate in ScreenWrite.frag
+        bool upsample = false;        //screenWrite() with upsample(), _Upsample in ScreenWrite.frag
+        bool probeUV = false;         //_ProbeUV in ScreenWrite.frag
+        int screenLayer = 0;          //_Layer in ScreenWrite.frag
+    };
+
+    // Loads the scene from a TGA file: red = wall, green = emitter. Generates the cascade shaders
+    // for cascadeCount levels, see CascadePreprocessor.hpp.
+    GpuCascades(const std::string& sceneFile, int cascadeCount = 6);
+    ~GpuCascades();
+
+    GpuCascades(const GpuCascades&) = delete;
+    GpuCascades& operator=(const GpuCascades&) = delete;
+
+    Settings& settings() { return settings_; }
+    const Settings& settings() const { return settings_; }
+    int cascadeCount() const { return cascadeCount_; }
+
+    // Reallocates the cascades in format and builds the shaders that use them again. Leaves the
+    // cascades empty and not upToDate().
+    void setStorageFormat(StorageFormat format);
+    StorageFormat storageFormat() const { return storageFormat_; }
+    // Two layers for all levels, even levels in one and odd levels in the other, a quarter of the
+    // memory of 7 layers. gather() then gathers the highest merged level, and each level below
+    // merges the one above into itself right after its gather. merge() does nothing, gather() did
+    // it, the per level gather is always used and edits relight everything. Each level's fluence
+    // is built before its layer is reused, but only layer 0 of the cascades is left to read.
+    // Reallocates like setStorageFormat().
+    void setPingPongStorage(bool pingPong);
+    bool pingPongStorage() const { return pingPong_; }
+    // Stores each layer as an image of every probe per direction instead of a block of every
+    // direction per probe. The per layer merge then runs in that order, and with the float
+    // formats interpolates the 4 neighbour probes of a direction in one filtered fetch.
+    // settings().directionBlocks is ignored with it. Rebuilds the shaders like setStorageFormat().
+    void setDirectionMajorStorage(bool directionMajor);
+    bool directionMajorStorage() const { return directionMajor_; }
+    // Spaces the probes of every level scale times as far apart (1, 2 or 4, rounded down to one of
+    // them), level 0 then has a probe per 2 * scale cells. Every level keeps its ray lengths but has
+    // 1 / scale^2 of the probes and rays, in layers layerSide() wide, so the gather and merge cost
+    // about that much less. The screen write and upsample() interpolate the coarser probes.
+    // Reallocates like setStorageFormat().
+    void setProbeScale(int scale);
+    int probeScale() const { return probeScale_; }
+    // Texels per side of a layer, CASCADE_TEXTURE_SIDE / probeScale(). Mip N of the fluence
+    // texture is layerSide() >> (N + 1) wide, a texel per probe.
+    int layerSide() const { return CASCADE_TEXTURE_SIDE / probeScale_; }
+
+    // GenerateSceneBitmap.comp, turns the scene texture into the bitmap again. Undoes paint(), call
+    // occupancyPyramid().build() and jumpFlood().build() afterwards.
+    void generateBitmap();
+
+    void gather(bool dirtyOnly = false);
+    void merge(bool dirtyOnly = false);
+    // single steps of gather() and merge(), for timing them separately
+    void gatherLevel(int level, bool dirtyOnly = false);
+    void gatherAll(bool dirtyOnly = false);  //every gatherLevel() in one dispatch
+    // every gatherLevel() in one dispatch of persistent groups that pull rays until none are left
+    void gatherPersistent(bool dirtyOnly = false);
+    void mergeLayer(int sourceLayer, bool dirtyOnly = false);  //sourceLayer into sourceLayer - 1
+    // every mergeLayer() from settings().highestLayer down in one dispatch, and one more for the
+    // lowest two with fusesLowestSteps(). Same result in layer 0 and the fluence
+    void mergeFused(bool dirtyOnly = false);
+    // ReduceFluence.comp for every gathered layer, merge() does it as its last step. The screen
+    // write and any other reader of fluence() see the result.
+    void buildFluence();
+    void buildFluenceLevel(int level);
+    // BiCubicInterpolation.comp, rebuilds the light of every cell of the bitmap from the fluence of
+    // the screen layer, leaving out the probes behind walls. screenWrite() does it with
+    // settings().upsample.
+    void upsample();
+    // draws a full screen quad into the bound framebuffer, covering the viewport. Reads the
+    // fluence texture, the upsampled one with settings().upsample, or the cascades without
+    // settings().interpolate. Shows settings().screenLayer, or lowestLevel if that's higher
+    void screenWrite();
+
+    // gather() + merge()
+    void relight();
+    // The cascades hold a relight made with the current settings.
+    bool upToDate() const;
+
+    // Sets cells [x, x + w) x [y, y + h) to value (see WALL_MASK/EMITTER_MASK), clamped to the
+    // bitmap. Keeps the occupancy pyramid and distance field up to date, but not the cascades.
+    void paint(int x, int y, int w, int h, GLubyte value);
+    bool hasEdits() const { return !dirtyProbes_.empty(); }
+    // Relights the texels affected by the edits since the last relight, or everything if the
+    // cascades aren't upToDate().
+    void relightEdits();
+
+    // Picks the local sizes from the cache, timing the kernels that aren't in it, or all of them
+    // with retune. Leaves the cascades unmerged and not upToDate().
+    void tuneWorkGroups(bool retune = false);
+
+    // Rays per second of a full gather, from the profiler's averages. 0 until it has samples.
+    double raysPerSecond() const;
+    // Gathers every level once and returns how long that took on the GPU, in nanoseconds.
+    // Leaves the layers unmerged.
+    GLuint64 timeGather();
+    // Gathers every level once and returns the DDA/sphere trace iterations per ray of each level.
+    // Leaves the layers unmerged.
+    std::vector<double> countSteps();
+
+    // Reads back layerSide() x layerSide() RGBA texels of a layer, row by row,
+    // decoded from the storage format and layout: rgb = radiance, a = gotBlocked.
+    // Check layerMerged() first, layer 1 can hold the gathered rays instead of the merge.
+    std::vector<float> readLayer(int index) const;
+    // False if the last relight left the gathered rays in layer index instead of the merge:
+    // layer 1 when the fused merge kept it in shared memory, see Settings::keepMergedLayers.
+    bool layerMerged(int index) const { return index != 1 || !relitFusedLowest_; }
+    // Runs screenWrite() into a width x height float target and reads back the RGB pixels.
+    std::vector<float> readImage(int width, int height);
+    // Makes texture unit 11, which no shader reads, the active one, to create or resize a texture
+    // without unbinding one of the pipeline's.
+    static void bindScratchUnit();
+
+    GLuint bitmap() const { return bitmap_; }
+    GLuint cascades() const { return cascades_; }
+    // GL_RGBA16F, layerSide() / 2 wide with a mip per layer, linear filtering within a mip.
+    // Reallocated with the cascades
+    GLuint fluence() const { return fluence_; }
+    OccupancyPyramid& occupancyPyramid() { return occupancyPyramid_; }
+    JumpFlood& jumpFlood() { return jumpFlood_; }
+    GpuProfiler& profiler() { return profiler_; }
+
+private:
+    static constexpr int ALL_LEVELS = CASCADE_LAYER_COUNT;  //gather_ slot of CascadeAll.comp
+    static constexpr int SPLIT_LEVELS = ALL_LEVELS + 1;     //gather_ slot of CascadeSplit0.comp
+    static constexpr int PERSISTENT = SPLIT_LEVELS + CASCADE_LAYER_COUNT;  //CascadePersistent.comp
+    static constexpr int GATHER_SLOTS = PERSISTENT + 1;
+
+    // allocates cascades_ in storageFormat_ and the fluence at probeScale_, and builds every
+    // shader that reads or writes them, for the layout pingPong_ and directionMajor_ pick
+    void createCascadeStorage();
+    // a bit per texel of a layer, _BlockedBits in CascadeStorage.glsl
+    GLsizeiptr blockedBitsLayerWords() const {
+        return static_cast<GLsizeiptr>(layerSide()) * layerSide() / 32;
+    }
+    // builds gather_[slot] from shaders/generated/<file>.comp and gets its uniform locations
+    void createGatherShader(int slot, const std::string& file, const std::string& defines = "");
+    void createMergeShader();  //with mergeGroup_
+    void createFusedMergeShader();
+    void createScreenWriteShader();
+    void createFluenceShader();
+    // allocates directionBlocks_ on first use and binds it to image unit 3 for a merge
+    void bindDirectionBlocks();
+    void gatherMergePingPong();  //gather() + merge() with setPingPongStorage()
+    void uploadGatherSettings(int slot);  //level, ALL_LEVELS, SPLIT_LEVELS + level or PERSISTENT
+    int gatherSlot(int level) const;      //the shader gatherLevel() uses
+    int lowestLevel() const;              //settings().lowestLevel within the gathered levels
+    // mergeFused() merges layer 2 into 1 into 0 in shared memory, in a dispatch of its own after
+    // the others. Layer 1 isn't written, the merge writes mip 1 of the fluence instead. Not while
+    // merged layer 1 is read, with keepMergedLayers or the texel view of layer 1.
+    bool fusesLowestSteps() const;
+
+    int cascadeCount_;
+    Settings settings_;
+    Settings relitSettings_;  //what the cascades were relit with
+    bool relitFusedLowest_ = false;  //fusesLowestSteps() of the last relight
+    bool relit_ = false;
+
+    Texture sceneTexture_;
+    Shader bitmapGenerator_;
+    GLuint bitmap_ = 0;
+    GLuint materialAtlas_ = 0;
+    GLuint cascades_ = 0;
+    GLuint blockedBits_ = 0;
+    GLuint fluence_ = 0;
+    GLuint directionBlocks_ = 0;  //0 until settings().directionBlocks is used
+    GLuint upsampled_ = 0;
+    StorageFormat storageFormat_ = StorageFormat::Rgba16f;
+    bool pingPong_ = false;
+    bool directionMajor_ = false;
+    int probeScale_ = 1;
+    GLuint cascadeFilter_ = 0;  //linear sampler object on TU 5
+    std::string storageDefines_;  //the format's #define + CascadeStorage.glsl
+    GLuint stepCounts_ = 0;
+    GLuint mergeProgress_ = 0;
+    GLuint rayQueue_ = 0;
+    GLuint gatherTimers_[2] = {};  //GL_TIMESTAMP before and after timeGather()
+    GLuint quadVAO_ = 0;
+    GLuint quadVBO_ = 0;
+
+    OccupancyPyramid occupancyPyramid_;
+    JumpFlood jumpFlood_;
+    DirtyProbes dirtyProbes_;
+    GpuProfiler profiler_;
+    std::string gatherPasses_[2][CASCADE_LAYER_COUNT];  //profiler names, [dirtyOnly][level]
+    std::string mergePasses_[2][CASCADE_LAYER_COUNT];
+    std::string gatherAllPasses_[2];
+    std::string persistentPasses_[2];
+    std::string fusedPasses_[2];
+    std::string fluencePasses_[CASCADE_LAYER_COUNT];
+
+    //local sizes, the defaults of the shaders until tuneWorkGroups()
+    WorkGroupSize gatherGroups_[CASCADE_LAYER_COUNT] = {{16, 16}, {16, 16}, {16, 16}, {16, 16},
+                                                        {16, 16}, {16, 16}, {16, 16}};
+    WorkGroupSize mergeGroup_ = {16, 16};
+    WorkGroupSize bitmapGroup_ = {8, 8};
+
+    Shader gather_[GATHER_SLOTS];
+    GLint rayLengthMultiplierLoc_[GATHER_SLOTS];
+    GLint skipEmptySpaceLoc_[GATHER_SLOTS];
+    GLint sphereTraceLoc_[GATHER_SLOTS];
+    GLint countStepsLoc_[GATHER_SLOTS];
+    GLint dirtyOnlyLoc_[GATHER_SLOTS];
+    GLint bitmapTileLoc_[GATHER_SLOTS];
+    GLint maxBatchesLoc_;
+
+    Shader merge_;
+    GLint mergeLoc_;
+    GLint sourceLayerLoc_;
+    GLint mergeDirtyOnlyLoc_;
+    GLint mergeDirectionBlocksLoc_;
+    GLint sourceBlocksLoc_;
+
+    Shader fusedMerge_;
+    GLint fusedHighestLayerLoc_;
+    GLint fusedMergeLoc_;
+    GLint fusedDirtyOnlyLoc_;
+    GLint fusedDirectionBlocksLoc_;
+    Shader fusedLowest_;  //FusedMerge.comp with FUSED_MERGE_LOWEST
+    GLint lowestHighestLayerLoc_;
+    GLint lowestDirtyOnlyLoc_;
+    GLint lowestDirectionBlocksLoc_;
+
+    Shader reduceFluence_;
+    GLint fluenceLevelLoc_;
+
+    Shader upsample_;
+    GLint upsampleLevelLoc_;
+
+    Shader screenWrite_;
+    GLint layerLoc_;
+    GLint interpolateLoc_;
+    GLint upsampleLoc_;
+    GLint probeUVLoc_;
+};
@@ -0,0 +1,140 @@
+#include "GpuProfiler.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <ostream>
+
+GpuProfiler::~GpuProfiler() {
+    for (Frame& frame : frames_) {
+        if (!frame.queries.empty()) {
+            glDeleteQueries(static_cast<GLsizei>(frame.queries.size()), frame.queries.data());
+        }
+    }
+}
+
+void GpuProfiler::setEnabled(bool enabled) {
+    enabled_ = enabled;
+    open_.clear();
+}
+
+void GpuProfiler::beginFrame() {
+    if (!enabled_) return;
+    frameIndex_ = (frameIndex_ + 1) % FRAMES_IN_FLIGHT;
+    Frame& frame = frames_[frameIndex_];
+    collect(frame);
+    frame.used = 0;
+    frame.timings.clear();
+    open_.clear();
+}
+
+void GpuProfiler::begin(const std::string& pass) {
+    if (!enabled_) return;
+    Frame& frame = frames_[frameIndex_];
+    const GLuint query = nextQuery(frame);
+    glQueryCounter(query, GL_TIMESTAMP);
+    open_.push_back(frame.timings.size());
+    frame.timings.push_back({passIndex(pass), query, 0});
+}
+
+void GpuProfiler::end() {
+    if (!enabled_ || open_.empty()) return;
+    Frame& frame = frames_[frameIndex_];
+    const GLuint query = nextQuery(frame);
+    glQueryCounter(query, GL_TIMESTAMP);
+    frame.timings[open_.back()].endQuery = query;
+    open_.pop_back();
+}
+
+void GpuProfiler::finish() {
+    if (!enabled_) return;
+    glFinish();
+    for (int i = 0; i < FRAMES_IN_FLIGHT; i++) beginFrame();
+}
+
+std::vector<GpuProfiler::PassStats> GpuProfiler::stats() const {
+    std::vector<PassStats> stats;
+    stats.reserve(passes_.size());
+    for (const Pass& pass : passes_) {
+        const int samples = std::min(pass.count, AVERAGE_WINDOW);
+        const double last = pass.count > 0 ? pass.samples[(pass.count - 1) % AVERAGE_WINDOW] : 0;
+        stats.push_back({pass.name, samples > 0 ? pass.sum / samples : 0, last, samples});
+    }
+    return stats;
+}
+
+double GpuProfiler::average(const std::string& pass) const {
+    for (const Pass& p : passes_) {
+        if (p.name == pass) {
+            const int samples = std::min(p.count, AVERAGE_WINDOW);
+            return samples > 0 ? p.sum / samples : 0;
+        }
+    }
+    return 0;
+}
+
+void GpuProfiler::reset() {
+    for (Pass& pass : passes_) {
+        pass.count = 0;
+        pass.sum = 0;
+    }
+    dropped_ = 0;
+}
+
+void GpuProfiler::print(std::ostream& out) const {
+    std::ios state(nullptr);
+    state.copyfmt(out);
+    out << "GPU passes (ms, average of the last " << AVERAGE_WINDOW << " samples):\n"
+        << std::fixed << std::setprecision(3);
+    for (const PassStats& pass : stats()) {
+        out << "  " << std::left << std::setw(18) << pass.name << std::right << std::setw(10)
+            << pass.averageMs << "  last " << std::setw(10) << pass.lastMs << "  n " << pass.samples
+            << "\n";
+    }
+    if (dropped_ > 0) out << "  " << dropped_ << " samples dropped, GPU more than "
+                          << FRAMES_IN_FLIGHT << " frames behind\n";
+    out.copyfmt(state);
+}
+
+int GpuProfiler::passIndex(const std::string& name) {
+    for (size_t i = 0; i < passes_.size(); i++) {
+        if (passes_[i].name == name) return static_cast<int>(i);
+    }
+    passes_.emplace_back();
+    passes_.back().name = name;
+    return static_cast<int>(passes_.size() - 1);
+}
+
+GLuint GpuProfiler::nextQuery(Frame& frame) {
+    if (frame.used == frame.queries.size()) {
+        GLuint query;
+        glGenQueries(1, &query);
+        frame.queries.push_back(query);
+    }
+    return frame.queries[frame.used++];
+}
+
+void GpuProfiler::collect(Frame& frame) {
+    for (const Timing& timing : frame.timings) {
+        if (timing.endQuery == 0) continue;  //never ended
+        //queries complete in order, the end one being done means the begin one is too
+        GLint available = 0;
+        glGetQueryObjectiv(timing.endQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) {
+            dropped_++;
+            continue;
+        }
+        GLuint64 begin = 0, end = 0;
+        glGetQueryObjectui64v(timing.beginQuery, GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(timing.endQuery, GL_QUERY_RESULT, &end);
+        addSample(passes_[static_cast<size_t>(timing.pass)],
+                  static_cast<double>(end - begin) / 1e6);
+    }
+}
+
+void GpuProfiler::addSample(Pass& pass, double ms) {
+    double& slot = pass.samples[pass.count % AVERAGE_WINDOW];
+    if (pass.count >= AVERAGE_WINDOW) pass.sum -= slot;
+    slot = ms;
+    pass.sum += ms;
+    pass.count++;
+}
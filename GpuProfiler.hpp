@@ -0,0 +1,90 @@
+/*
+ * GPU time per pass without stalling: begin()/end() put a GL_TIMESTAMP query on each side of a
+ * pass, and the results are read FRAMES_IN_FLIGHT frames later, when the GPU is long done with
+ * them. A pass is a name, every sample of it goes into a rolling average over the last
+ * AVERAGE_WINDOW samples.
+ *
+ * Usage: beginFrame() once per frame, then begin("name") / end() around the GL calls of each pass.
+ * Passes can nest. stats() returns the averages, print() dumps them to the console.
+ * Queries whose results aren't available when their frame slot comes around again are dropped
+ * instead of waited on, see dropped().
+ */
+#pragma once
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+
+class GpuProfiler {
+public:
+    static constexpr int FRAMES_IN_FLIGHT = 4;
+    static constexpr int AVERAGE_WINDOW = 64;  //samples per rolling average
+
+    struct PassStats {
+        std::string name;
+        double averageMs;  //over the last AVERAGE_WINDOW samples
+        double lastMs;
+        int samples;       //in the average
+    };
+
+    GpuProfiler() = default;
+    ~GpuProfiler();
+
+    GpuProfiler(const GpuProfiler&) = delete;
+    GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+    // Off: begin(), end() and beginFrame() do nothing. Turning it off keeps the averages.
+    void setEnabled(bool enabled);
+    bool enabled() const { return enabled_; }
+
+    // Reads back the frame slot that gets reused, then starts recording into it.
+    void beginFrame();
+    void begin(const std::string& pass);
+    void end();
+    // Waits for and reads back every frame still in flight. For the end of a run, not per frame.
+    void finish();
+
+    // In the order the passes were first seen.
+    std::vector<PassStats> stats() const;
+    // Average of a pass in milliseconds, 0 if it has no samples yet.
+    double average(const std::string& pass) const;
+    void reset();
+    int dropped() const { return dropped_; }
+
+    // One line per pass: average, last sample and the sample count.
+    void print(std::ostream& out) const;
+
+private:
+    struct Pass {
+        std::string name;
+        double samples[AVERAGE_WINDOW] = {};  //ring, milliseconds
+        int count = 0;                         //samples written, the ring is full past AVERAGE_WINDOW
+        double sum = 0;
+    };
+
+    struct Timing {
+        int pass;
+        GLuint beginQuery;
+        GLuint endQuery;
+    };
+
+    struct Frame {
+        std::vector<GLuint> queries;  //pool, grows to what the busiest frame needs
+        size_t used = 0;
+        std::vector<Timing> timings;
+    };
+
+    int passIndex(const std::string& name);
+    GLuint nextQuery(Frame& frame);
+    void collect(Frame& frame);
+    void addSample(Pass& pass, double ms);
+
+    bool enabled_ = false;
+    int frameIndex_ = 0;
+    Frame frames_[FRAMES_IN_FLIGHT];
+    std::vector<Pass> passes_;
+    std::vector<size_t> open_;  //timings begun but not ended, innermost last
+    int dropped_ = 0;
+};
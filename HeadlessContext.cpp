@@ -0,0 +1,101 @@
+#include <GL/glew.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include "HeadlessContext.hpp"
+
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+bool hasExtension(const char* extensions, const char* name) {
+    return extensions != nullptr && std::strstr(extensions, name) != nullptr;
+}
+
+}  // namespace
+
+HeadlessContext::HeadlessContext() {
+    //surfaceless Mesa first, needs no display server or render node permissions for llvmpipe
+    EGLDisplay display = EGL_NO_DISPLAY;
+    const char* clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+        eglGetProcAddress("eglGetPlatformDisplayEXT"));
+    if (getPlatformDisplay && hasExtension(clientExtensions, "EGL_MESA_platform_surfaceless")) {
+        display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    }
+    if (display == EGL_NO_DISPLAY) {
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+    EGLint major, minor;
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+        std::cerr << "Error: no EGL display\n";
+        return;
+    }
+    display_ = display;
+    eglBindAPI(EGL_OPENGL_API);
+
+    const char* extensions = eglQueryString(display, EGL_EXTENSIONS);
+    const bool surfaceless = hasExtension(extensions, "EGL_KHR_surfaceless_context");
+
+    const EGLint configAttributes[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_NONE
+    };
+    EGLConfig config = EGL_NO_CONFIG_KHR;
+    EGLint configCount = 0;
+    eglChooseConfig(display, configAttributes, &config, 1, &configCount);
+    if (configCount == 0 && !hasExtension(extensions, "EGL_KHR_no_config_context")) {
+        std::cerr << "Error: no EGL config for a desktop GL pbuffer\n";
+        return;
+    }
+
+    const EGLint contextAttributes[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 4,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    EGLContext context = eglCreateContext(display, configCount > 0 ? config : EGL_NO_CONFIG_KHR,
+                                          EGL_NO_CONTEXT, contextAttributes);
+    if (context == EGL_NO_CONTEXT) {
+        std::cerr << "Error: could not create a GL 4.3 core context (EGL error 0x" << std::hex
+                  << eglGetError() << std::dec << ")\n";
+        return;
+    }
+    context_ = context;
+
+    //a surface is only needed when the driver can't do without
+    EGLSurface surface = EGL_NO_SURFACE;
+    if (!surfaceless && configCount > 0) {
+        const EGLint pbufferAttributes[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+        surface = eglCreatePbufferSurface(display, config, pbufferAttributes);
+        surface_ = surface;
+    }
+    if (eglMakeCurrent(display, surface, surface, context) != EGL_TRUE) {
+        std::cerr << "Error: could not make the EGL context current\n";
+        return;
+    }
+
+    //core profile, glew needs this to look up every entry point
+    glewExperimental = GL_TRUE;
+    GLenum err = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+    //a GLX build of an external glew has loaded the GL entry points by the time it finds no X
+    if (err == GLEW_ERROR_NO_GLX_DISPLAY) err = GLEW_OK;
+#endif
+    if (GLEW_OK != err) {
+        std::cerr << "Error: " << glewGetErrorString(err) << "\n";
+        return;
+    }
+    current_ = true;
+}
+
+HeadlessContext::~HeadlessContext() {
+    if (display_ == nullptr) return;
+    eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (surface_ != nullptr) eglDestroySurface(display_, surface_);
+    if (context_ != nullptr) eglDestroyContext(display_, context_);
+    eglTerminate(display_);
+}
@@ -0,0 +1,29 @@
+/*
+ * A GL 4.3 core context without a window, for the headless tools.
+ *
+ * Made with EGL, on Mesa's surfaceless platform if there is one and on the default display with a
+ * 1x1 pbuffer otherwise. Everything renders into FBOs, so the surface is never drawn to. glew is
+ * initialized once the context is current.
+ *
+ * Usage: create one before any GL call and check current(). It has to outlive every GL object.
+ */
+#pragma once
+
+class HeadlessContext {
+public:
+    HeadlessContext();
+    ~HeadlessContext();
+
+    HeadlessContext(const HeadlessContext&) = delete;
+    HeadlessContext& operator=(const HeadlessContext&) = delete;
+
+    // the context got made current and glew found the GL entry points
+    bool current() const { return current_; }
+
+private:
+    //EGL handles, void* so this header doesn't pull in the EGL headers
+    void* display_ = nullptr;
+    void* context_ = nullptr;
+    void* surface_ = nullptr;
+    bool current_ = false;
+};
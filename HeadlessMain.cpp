@@ -0,0 +1,223 @@
+/*
+ * Runs the GL cascade pipeline without a window and writes the result to disk. The context comes
+ * from EGL (see HeadlessContext.hpp), so it runs on headless servers and under llvmpipe.
+ *
+ * Usage: radiance-cascades-headless <scene.tga> <output.tga|.pfm> [options]
+ *   --cascades N   amount of gathered levels (default 6)
+ *   --highest N    merging starts from this layer (default 6)
+ *   --layer N      layer to write to the output image (default 0)
+ *   --lowest N     don't gather or merge the levels below N, write level N at least (default 0).
+ *                  drops the light near the probes, --probe-scale is the cheaper hierarchy
+ *   --rlm N        ray length multiplier (default 1)
+ *   --no-merge     skip the bilinear merge
+ *   --no-fuse      merge with one dispatch per layer instead of FusedMerge.comp
+ *   --direction-blocks  merge from the layers averaged over groups of 4 directions
+ *   --one-gather   gather every level in one dispatch of CascadeAll.comp
+ *   --persistent   gather with persistent groups pulling rays from a queue, CascadePersistent.comp
+ *   --split        march the long rays of level 3 and up in pieces, see CascadeSplitN.comp
+ *   --retune       time the work group sizes again instead of using the cached ones
+ *   --tile-levels N  levels below N march a shared memory copy of the bitmap (default 0 = off)
+ *   --format NAME  cascade storage: rgba16f (default), r11f_g11f_b10f, rgb9e5 or packed32
+ *   --ping-pong    two cascade layers instead of seven, gathered and merged a level at a time. the
+ *                  gather time includes the merge, --layers only writes layer 0
+ *   --direction-major  store an image of every probe per direction instead of a block per probe
+ *   --probe-scale N  probes N times as far apart, 1, 2 or 4 (default 1). 1 / N^2 of the rays
+ *   --no-interp    no bilinear interpolation in the screen write
+ *   --upsample     rebuild every cell from the probes around it, see BiCubicInterpolation.comp
+ *   --no-skip      plain DDA, no empty space skipping with the occupancy pyramid
+ *   --sphere       sphere trace the jump flooded distance field
+ *   --repeat N     relight N times and print the average times (default 1)
+ *   --profile      also print the GPU time of every pass, see GpuProfiler.hpp
+ *   --layers PATH  also write every merged cascade layer, as PATH0.pfm, PATH1.pfm, ...
+ *
+ * Has to run from the directory that holds shaders/, like the viewer.
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "CascadeConstants.hpp"
+#include "GpuCascades.hpp"
+#include "HeadlessContext.hpp"
+#include "ImageIO.hpp"
+
+namespace {
+
+void printUsage() {
+    std::cout << "Usage: radiance-cascades-headless <scene.tga> <output.tga|.pfm> [--cascades N] "
+                 "[--highest N] [--layer N] [--lowest N] [--rlm N] [--no-merge] [--no-fuse] "
+                 "[--direction-blocks] [--one-gather] [--persistent] [--split] [--retune] "
+                 "[--tile-levels N] [--format NAME] [--ping-pong] [--direction-major] "
+                 "[--probe-scale N] [--no-interp] [--upsample] [--no-skip] [--sphere] "
+                 "[--repeat N] [--profile] [--layers PATH]\n";
+}
+
+double millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start)
+        .count();
+}
+
+bool endsWith(const std::string& s, const std::string& suffix) {
+    return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        printUsage();
+        return 1;
+    }
+    const std::string scenePath = argv[1];
+    const std::string outputPath = argv[2];
+
+    int cascadeCount = 6;
+    int repeat = 1;
+    bool profile = false;
+    bool retune = false;
+    GpuCascades::StorageFormat format = GpuCascades::StorageFormat::Rgba16f;
+    bool pingPong = false;
+    bool directionMajor = false;
+    int probeScale = 1;
+    std::string layersPath;
+    GpuCascades::Settings settings;
+    for (int i = 3; i < argc; i++) {
+        const bool hasValue = i + 1 < argc;
+        if (std::strcmp(argv[i], "--cascades") == 0 && hasValue) {
+            cascadeCount = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--highest") == 0 && hasValue) {
+            settings.highestLayer = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--layer") == 0 && hasValue) {
+            settings.screenLayer = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--lowest") == 0 && hasValue) {
+            settings.lowestLevel = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--rlm") == 0 && hasValue) {
+            settings.rayLengthMultiplier = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--no-merge") == 0) {
+            settings.merge = false;
+        } else if (std::strcmp(argv[i], "--no-fuse") == 0) {
+            settings.fusedMerge = false;
+        } else if (std::strcmp(argv[i], "--direction-blocks") == 0) {
+            settings.directionBlocks = true;
+        } else if (std::strcmp(argv[i], "--one-gather") == 0) {
+            settings.gatherMode = GpuCascades::GatherMode::SingleDispatch;
+        } else if (std::strcmp(argv[i], "--persistent") == 0) {
+            settings.gatherMode = GpuCascades::GatherMode::Persistent;
+        } else if (std::strcmp(argv[i], "--split") == 0) {
+            settings.splitRays = true;
+        } else if (std::strcmp(argv[i], "--retune") == 0) {
+            retune = true;
+        } else if (std::strcmp(argv[i], "--tile-levels") == 0 && hasValue) {
+            settings.bitmapTileLevels = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--format") == 0 && hasValue) {
+            if (!GpuCascades::storageFormatFromName(argv[++i], format)) {
+                std::cerr << "Unknown storage format: " << argv[i] << "\n";
+                printUsage();
+                return 1;
+            }
+        } else if (std::strcmp(argv[i], "--ping-pong") == 0) {
+            pingPong = true;
+        } else if (std::strcmp(argv[i], "--direction-major") == 0) {
+            directionMajor = true;
+        } else if (std::strcmp(argv[i], "--probe-scale") == 0 && hasValue) {
+            probeScale = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--no-interp") == 0) {
+            settings.interpolate = false;
+        } else if (std::strcmp(argv[i], "--upsample") == 0) {
+            settings.upsample = true;
+        } else if (std::strcmp(argv[i], "--no-skip") == 0) {
+            settings.skipEmptySpace = false;
+        } else if (std::strcmp(argv[i], "--sphere") == 0) {
+            settings.sphereTrace = true;
+        } else if (std::strcmp(argv[i], "--repeat") == 0 && hasValue) {
+            repeat = std::max(std::atoi(argv[++i]), 1);
+        } else if (std::strcmp(argv[i], "--profile") == 0) {
+            profile = true;
+        } else if (std::strcmp(argv[i], "--layers") == 0 && hasValue) {
+            layersPath = argv[++i];
+        } else {
+            std::cerr << "Unknown argument: " << argv[i] << "\n";
+            printUsage();
+            return 1;
+        }
+    }
+
+    HeadlessContext context;
+    if (!context.current()) return 1;
+    std::cout << "GL renderer: " << glGetString(GL_RENDERER)
+              << "\nGL version:  " << glGetString(GL_VERSION) << "\n";
+
+    auto start = std::chrono::steady_clock::now();
+    GpuCascades cascades(scenePath, cascadeCount);
+    cascades.setStorageFormat(format);
+    cascades.setPingPongStorage(pingPong);
+    cascades.setDirectionMajorStorage(directionMajor);
+    cascades.setProbeScale(probeScale);
+    if (retune) cascades.tuneWorkGroups(true);
+    settings.keepMergedLayers = !layersPath.empty();
+    cascades.settings() = settings;
+    cascades.profiler().setEnabled(profile);
+    glFinish();
+    std::cout << "setup:        " << millisecondsSince(start) << " ms\n";
+
+    //glFinish() after each stage, the times are for the GPU work and not for queueing it
+    double gatherTime = 0, mergeTime = 0;
+    for (int i = 0; i < repeat; i++) {
+        cascades.profiler().beginFrame();
+        start = std::chrono::steady_clock::now();
+        cascades.gather();
+        glFinish();
+        gatherTime += millisecondsSince(start);
+
+        start = std::chrono::steady_clock::now();
+        cascades.merge();
+        glFinish();
+        mergeTime += millisecondsSince(start);
+    }
+    std::cout << "gather:       " << gatherTime / repeat << " ms\n"
+              << "merge:        " << mergeTime / repeat << " ms\n";
+
+    start = std::chrono::steady_clock::now();
+    std::vector<float> image = cascades.readImage(CASCADE_TEXTURE_SIDE, CASCADE_TEXTURE_SIDE);
+    std::cout << "screen write: " << millisecondsSince(start) << " ms\n";
+    if (profile) {
+        cascades.profiler().finish();
+        cascades.profiler().print(std::cout);
+    }
+
+    const bool written =
+        endsWith(outputPath, ".pfm")
+            ? imageio::writePFM(outputPath, CASCADE_TEXTURE_SIDE, CASCADE_TEXTURE_SIDE, image)
+            : imageio::writeTGA(outputPath, CASCADE_TEXTURE_SIDE, CASCADE_TEXTURE_SIDE,
+                                imageio::toRGB8(image));
+    if (!written) return 1;
+    std::cout << "Wrote " << outputPath << "\n";
+
+    if (!layersPath.empty()) {
+        //the other levels share the two layers of ping-pong storage, overwritten by the merge
+        const int layers = cascades.pingPongStorage() ? 1 : CASCADE_LAYER_COUNT;
+        for (int layer = 0; layer < layers; layer++) {
+            if (!cascades.layerMerged(layer)) {
+                std::cerr << "Layer " << layer << " holds the gathered rays, not the merge\n";
+            }
+            std::vector<float> rgba = cascades.readLayer(layer);
+            std::vector<float> rgb(rgba.size() / 4 * 3);
+            for (size_t t = 0; t < rgba.size() / 4; t++) {
+                rgb[t * 3 + 0] = rgba[t * 4 + 0];
+                rgb[t * 3 + 1] = rgba[t * 4 + 1];
+                rgb[t * 3 + 2] = rgba[t * 4 + 2];
+            }
+            const std::string path = layersPath + std::to_string(layer) + ".pfm";
+            const int side = cascades.layerSide();
+            if (!imageio::writePFM(path, side, side, rgb)) return 1;
+            std::cout << "Wrote " << path << "\n";
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,144 @@
+/*
+ * GL-free TGA loading and saving, PFM saving.
+ *
+ * The loader follows the one in Texture.cpp, minus the GL upload.
+ */
+#include "ImageIO.hpp"
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <iostream>
+
+namespace imageio {
+
+Image loadTGA(const std::string& filename) {
+    std::ifstream in(filename, std::ios_base::in | std::ios_base::binary);
+    if (!in.is_open()) {
+        std::cerr << "Could not open image file ('" << filename << "')\n";
+        return {};
+    }
+
+    std::array<char, 12> tgaheader;
+    in.read(tgaheader.data(), sizeof(tgaheader));
+    if (in.fail()) {
+        std::cerr << "Could not read file header ('" << filename << "')\n";
+        return {};
+    }
+
+    const std::array<char, 12> uncompressedTGA = {{0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0}};
+    if (tgaheader != uncompressedTGA) {
+        std::cerr << "Only uncompressed TGA files are supported ('" << filename << "')\n";
+        return {};
+    }
+
+    std::array<std::uint8_t, 6> header;
+    in.read(reinterpret_cast<char*>(header.data()), sizeof(header));
+    if (in.fail()) {
+        std::cerr << "Could not read TGA header ('" << filename << "')\n";
+        return {};
+    }
+
+    Image image;
+    image.width = header[1] * 256 + header[0];
+    image.height = header[3] * 256 + header[2];
+    if (image.width <= 0 || image.height <= 0) {
+        std::cerr << "Invalid image dimensions ('" << filename << "')\n";
+        return {};
+    }
+
+    const int bpp = header[4];
+    if (bpp != 24 && bpp != 32) {
+        std::cerr << "Unsupported number of bits per pixel (" << bpp << ") ('" << filename
+                  << "')\n";
+        return {};
+    }
+    image.channels = bpp / 8;
+
+    const size_t imageSize = static_cast<size_t>(image.channels) * image.width * image.height;
+    image.data.resize(imageSize);
+    in.read(reinterpret_cast<char*>(image.data.data()), static_cast<std::streamsize>(imageSize));
+    if (static_cast<size_t>(in.gcount()) != imageSize) {
+        std::cerr << "Could not read image data ('" << filename << "')\n";
+        return {};
+    }
+
+    // BGR(A) -> RGB(A)
+    for (size_t i = 0; i < imageSize; i += static_cast<size_t>(image.channels)) {
+        std::swap(image.data[i], image.data[i + 2]);
+    }
+
+    return image;
+}
+
+bool writeTGA(const std::string& filename, int width, int height,
+              const std::vector<std::uint8_t>& rgb) {
+    const size_t imageSize = static_cast<size_t>(width) * height * 3;
+    if (width <= 0 || height <= 0 || width > 0xFFFF || height > 0xFFFF || rgb.size() < imageSize) {
+        std::cerr << "Invalid image passed to writeTGA ('" << filename << "')\n";
+        return false;
+    }
+
+    std::ofstream out(filename, std::ios_base::out | std::ios_base::binary);
+    if (!out.is_open()) {
+        std::cerr << "Could not open image file for writing ('" << filename << "')\n";
+        return false;
+    }
+
+    std::array<std::uint8_t, 18> header = {};
+    header[2] = 2;  // uncompressed true color
+    header[12] = static_cast<std::uint8_t>(width & 0xFF);
+    header[13] = static_cast<std::uint8_t>(width >> 8);
+    header[14] = static_cast<std::uint8_t>(height & 0xFF);
+    header[15] = static_cast<std::uint8_t>(height >> 8);
+    header[16] = 24;
+    out.write(reinterpret_cast<const char*>(header.data()), sizeof(header));
+
+    std::vector<std::uint8_t> bgr(rgb.begin(), rgb.begin() + static_cast<std::ptrdiff_t>(imageSize));
+    for (size_t i = 0; i < imageSize; i += 3) {
+        std::swap(bgr[i], bgr[i + 2]);
+    }
+    out.write(reinterpret_cast<const char*>(bgr.data()), static_cast<std::streamsize>(imageSize));
+
+    if (!out) {
+        std::cerr << "Could not write image data ('" << filename << "')\n";
+        return false;
+    }
+    return true;
+}
+
+bool writePFM(const std::string& filename, int width, int height, const std::vector<float>& rgb) {
+    const size_t imageSize = static_cast<size_t>(width) * height * 3;
+    if (width <= 0 || height <= 0 || rgb.size() < imageSize) {
+        std::cerr << "Invalid image passed to writePFM ('" << filename << "')\n";
+        return false;
+    }
+
+    std::ofstream out(filename, std::ios_base::out | std::ios_base::binary);
+    if (!out.is_open()) {
+        std::cerr << "Could not open image file for writing ('" << filename << "')\n";
+        return false;
+    }
+
+    // a negative scale means little endian, which is what x86 and ARM hosts write
+    out << "PF\n" << width << " " << height << "\n-1.0\n";
+    out.write(reinterpret_cast<const char*>(rgb.data()),
+              static_cast<std::streamsize>(imageSize * sizeof(float)));
+
+    if (!out) {
+        std::cerr << "Could not write image data ('" << filename << "')\n";
+        return false;
+    }
+    return true;
+}
+
+std::vector<std::uint8_t> toRGB8(const std::vector<float>& rgb) {
+    std::vector<std::uint8_t> out(rgb.size());
+    for (size_t i = 0; i < rgb.size(); i++) {
+        float v = std::clamp(rgb[i], 0.f, 1.f);
+        out[i] = static_cast<std::uint8_t>(v * 255.f + 0.5f);
+    }
+    return out;
+}
+
+}  // namespace imageio
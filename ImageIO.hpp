@@ -0,0 +1,41 @@
+/*
+ * GL-free image loading and saving, so scenes can be read and results written on machines
+ * without a GL context.
+ *
+ * Usage: call loadTGA() to read an uncompressed 24 or 32 bit TGA. Rows are kept in file order,
+ * which is the same order glTexImage2D() gets them in Texture.cpp, so texel (x, y) of the GL
+ * texture is pixel (x, y) of the loaded image. writeTGA() writes rows back in the same order.
+ * writePFM() keeps the full float range, for cascade layers and HDR results.
+ */
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace imageio {
+
+struct Image {
+    int width = 0;
+    int height = 0;
+    int channels = 0;                // 3 = RGB, 4 = RGBA
+    std::vector<std::uint8_t> data;  // RGB(A), row by row
+
+    bool empty() const { return data.empty(); }
+};
+
+// Load an uncompressed TGA file. Returns an empty image on failure.
+Image loadTGA(const std::string& filename);
+
+// Write 8 bit RGB data as an uncompressed 24 bit TGA.
+bool writeTGA(const std::string& filename, int width, int height,
+              const std::vector<std::uint8_t>& rgb);
+
+// Write float RGB data as a little endian PFM, unclamped. Rows are written in the same order as
+// writeTGA(), the first row is the bottom one in both formats.
+bool writePFM(const std::string& filename, int width, int height, const std::vector<float>& rgb);
+
+// Convert linear float RGB to 8 bit, clamping to [0, 1].
+std::vector<std::uint8_t> toRGB8(const std::vector<float>& rgb);
+
+}  // namespace imageio
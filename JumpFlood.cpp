@@ -0,0 +1,73 @@
+#include "JumpFlood.hpp"
+
+#include <algorithm>
+
+#include "Profiling.hpp"
+
+JumpFlood::JumpFlood(GLuint bitmapTexture, int width, int height)
+    : bitmapTexture_(bitmapTexture)
+    , width_(width)
+    , height_(height)
+    , seed_("shaders/JumpFloodSeed.comp")
+    , flood_("shaders/JumpFlood.comp")
+    , resolve_("shaders/JumpFloodResolve.comp") {
+    //closest occupied cell in xy, closest empty cell in zw. made on the field's unit, so the
+    //bindings of the other units stay as they are
+    glActiveTexture(GL_TEXTURE6);
+    glGenTextures(2, seeds_);
+    for (GLuint seeds : seeds_) {
+        glBindTexture(GL_TEXTURE_2D, seeds);
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA16I, width_, height_);
+    }
+
+    glGenTextures(1, &field_);  //on texture unit 6, where the cascade shaders read it
+    glBindTexture(GL_TEXTURE_2D, field_);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_R32F, width_, height_);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    stepSizeLoc_ = glGetUniformLocation(flood_.id(), "_StepSize");
+}
+
+JumpFlood::~JumpFlood() {
+    glDeleteTextures(2, seeds_);
+    if (field_ != 0) {
+        glDeleteTextures(1, &field_);
+    }
+}
+
+void JumpFlood::build() {
+    TracyGpuZone("jump flood");
+    const GLuint groupsX = static_cast<GLuint>((width_ + 7) / 8);
+    const GLuint groupsY = static_cast<GLuint>((height_ + 7) / 8);
+
+    glUseProgram(seed_.id());
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, bitmapTexture_);
+    glBindImageTexture(5, seeds_[0], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16I);
+    glDispatchCompute(groupsX, groupsY, 1);
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+    //half the bitmap down to 1, plus one more pass of 1 (JFA+1)
+    int largestStep = 1;
+    while (largestStep * 2 < std::max(width_, height_)) largestStep *= 2;
+
+    glUseProgram(flood_.id());
+    int current = 0;
+    for (int step = largestStep;; step /= 2) {
+        const int passStep = std::max(step, 1);
+        glBindImageTexture(5, seeds_[current], 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA16I);
+        glBindImageTexture(6, seeds_[1 - current], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16I);
+        glUniform1i(stepSizeLoc_, passStep);
+        glDispatchCompute(groupsX, groupsY, 1);
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+        current = 1 - current;
+        if (step == 0) break;
+    }
+
+    glUseProgram(resolve_.id());
+    glBindImageTexture(5, seeds_[current], 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA16I);
+    glBindImageTexture(7, field_, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+    glDispatchCompute(groupsX, groupsY, 1);
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+}
@@ -0,0 +1,42 @@
+/*
+ * Signed distance field of the scene bitmap, made with the jump flood algorithm on the GPU.
+ *
+ * JumpFloodSeed.comp seeds every cell with itself, log2(N) + 1 passes of JumpFlood.comp spread
+ * the closest occupied and closest empty cell to every cell, and JumpFloodResolve.comp turns that
+ * into distances. Same algorithm as the CPU version in DistanceField.hpp.
+ *
+ * Usage: create it after the bitmap texture and call build() whenever the bitmap changes. The
+ * R32F field is bound to texture unit 6 for the cascade shaders on creation.
+ */
+#pragma once
+
+#include <GL/glew.h>
+
+#include "Shader.hpp"
+
+class JumpFlood {
+public:
+    JumpFlood(GLuint bitmapTexture, int width, int height);
+    ~JumpFlood();
+
+    JumpFlood(const JumpFlood&) = delete;
+    JumpFlood& operator=(const JumpFlood&) = delete;
+
+    void build();
+
+    // the distance field
+    GLuint id() const { return field_; }
+
+private:
+    GLuint bitmapTexture_;
+    int width_;
+    int height_;
+
+    GLuint seeds_[2] = {0, 0};  //ping-pong
+    GLuint field_ = 0;
+
+    Shader seed_;
+    Shader flood_;
+    Shader resolve_;
+    GLint stepSizeLoc_;
+};
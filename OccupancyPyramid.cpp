@@ -0,0 +1,69 @@
+#include "OccupancyPyramid.hpp"
+
+#include <algorithm>
+
+#include "Profiling.hpp"
+
+OccupancyPyramid::OccupancyPyramid(GLuint bitmapTexture, int width, int height)
+    : bitmapTexture_(bitmapTexture)
+    , width_(width)
+    , height_(height)
+    , levels_(1)
+    , shader_("shaders/GenerateOccupancyPyramid.comp") {
+    //down to a single texel
+    while ((std::max(width_, height_) >> (levels_ - 1)) > 1) levels_++;
+
+    glGenTextures(1, &texture_);
+    glActiveTexture(GL_TEXTURE3);  //where the cascade shaders read it
+    glBindTexture(GL_TEXTURE_2D, texture_);
+    glTexStorage2D(GL_TEXTURE_2D, levels_, GL_R8UI, width_, height_);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    targetLevelLoc_ = glGetUniformLocation(shader_.id(), "_TargetLevel");
+    offsetLoc_ = glGetUniformLocation(shader_.id(), "_Offset");
+    sizeLoc_ = glGetUniformLocation(shader_.id(), "_Size");
+}
+
+OccupancyPyramid::~OccupancyPyramid() {
+    if (texture_ != 0) {
+        glDeleteTextures(1, &texture_);
+    }
+}
+
+void OccupancyPyramid::build() { update(0, 0, width_, height_); }
+
+void OccupancyPyramid::update(int x, int y, int w, int h) {
+    //clamp to the bitmap, nothing to do if that leaves nothing
+    const int x0 = std::max(x, 0);
+    const int y0 = std::max(y, 0);
+    const int x1 = std::min(x + w, width_);
+    const int y1 = std::min(y + h, height_);
+    if (x0 >= x1 || y0 >= y1) return;
+    TracyGpuZone("occupancy pyramid");
+
+    glUseProgram(shader_.id());
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, bitmapTexture_);
+
+    for (int level = 0; level < levels_; level++) {
+        //texels of this level that cover the changed cells
+        const int offsetX = x0 >> level;
+        const int offsetY = y0 >> level;
+        const int sizeX = ((x1 - 1) >> level) - offsetX + 1;
+        const int sizeY = ((y1 - 1) >> level) - offsetY + 1;
+
+        if (level > 0) {
+            glBindImageTexture(3, texture_, level - 1, GL_FALSE, 0, GL_READ_ONLY, GL_R8UI);
+        }
+        glBindImageTexture(4, texture_, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R8UI);
+        glUniform1i(targetLevelLoc_, level);
+        glUniform2i(offsetLoc_, offsetX, offsetY);
+        glUniform2i(sizeLoc_, sizeX, sizeY);
+
+        glDispatchCompute(static_cast<GLuint>((sizeX + 7) / 8),
+                          static_cast<GLuint>((sizeY + 7) / 8), 1);
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+    }
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+}
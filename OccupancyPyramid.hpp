@@ -0,0 +1,46 @@
+/*
+ * Max mip chain of the scene bitmap, used by Cascade.comp to jump over empty space.
+ *
+ * Level 0 has one texel per bitmap cell, its WALL_MASK and EMITTER_MASK bits. Every level above
+ * is the or of the 2x2 texels below it, so a 0 at level L means the 2^L x 2^L block of cells
+ * under it is empty. Built by GenerateOccupancyPyramid.comp, one dispatch per level.
+ *
+ * Usage: create it after the bitmap texture, call build() once GenerateSceneBitmap.comp has run
+ * and update() with the changed cells whenever the bitmap changes. The texture is bound to texture
+ * unit 3 for the cascade shaders on creation. The bitmap sides have to be powers of two.
+ */
+#pragma once
+
+#include <GL/glew.h>
+
+#include "Shader.hpp"
+
+class OccupancyPyramid {
+public:
+    OccupancyPyramid(GLuint bitmapTexture, int width, int height);
+    ~OccupancyPyramid();
+
+    OccupancyPyramid(const OccupancyPyramid&) = delete;
+    OccupancyPyramid& operator=(const OccupancyPyramid&) = delete;
+
+    // Builds every level from the bitmap.
+    void build();
+
+    // Rebuilds the texels of every level that cover the cells [x, x + w) x [y, y + h).
+    void update(int x, int y, int w, int h);
+
+    GLuint id() const { return texture_; }
+    int levels() const { return levels_; }
+
+private:
+    GLuint bitmapTexture_;
+    GLuint texture_ = 0;
+    int width_;
+    int height_;
+    int levels_;
+
+    Shader shader_;
+    GLint targetLevelLoc_;
+    GLint offsetLoc_;
+    GLint sizeLoc_;
+};
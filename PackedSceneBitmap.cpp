@@ -0,0 +1,101 @@
+#include "PackedSceneBitmap.hpp"
+
+#include <algorithm>
+
+#include "CascadeConstants.hpp"
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+namespace {
+
+//both are undefined for 0, callers check that first
+int countTrailingZeros(std::uint64_t v) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index;
+    _BitScanForward64(&index, v);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctzll(v);
+#endif
+}
+
+int countLeadingZeros(std::uint64_t v) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index;
+    _BitScanReverse64(&index, v);
+    return 63 - static_cast<int>(index);
+#else
+    return __builtin_clzll(v);
+#endif
+}
+
+// Zero bits from index on in a line of count bits, walking up or down. The padding bits past the
+// end of the last word have to be 0.
+int emptyRun(const std::uint64_t* line, int count, int index, int step) {
+    //padding past the end reads as empty, don't count it
+    const int limit = step > 0 ? count - index : index + 1;
+
+    int run = 0;
+    while (run < limit) {
+        const std::uint64_t word = line[index >> 6];
+        const int bit = index & 63;
+
+        //shift the cells ahead of index to the bottom (up) or the top (down) of the word
+        const std::uint64_t ahead = step > 0 ? word >> bit : word << (63 - bit);
+        if (ahead != 0) {
+            return std::min(limit,
+                            run + (step > 0 ? countTrailingZeros(ahead) : countLeadingZeros(ahead)));
+        }
+
+        const int free = step > 0 ? 64 - bit : bit + 1;
+        run += free;
+        index += free * step;
+    }
+    return limit;
+}
+
+}  // namespace
+
+PackedSceneBitmap::PackedSceneBitmap(const SceneBitmap& bitmap)
+    : width_(bitmap.width())
+    , height_(bitmap.height())
+    , wordsPerRow_((bitmap.width() + 63) / 64)
+    , blocksX_((bitmap.width() + BLOCK_SIZE - 1) / BLOCK_SIZE)
+    , blocksY_((bitmap.height() + BLOCK_SIZE - 1) / BLOCK_SIZE)
+    , blockWordsPerRow_((blocksX_ + 63) / 64)
+    , blockWordsPerColumn_((blocksY_ + 63) / 64)
+    , walls_(static_cast<size_t>(wordsPerRow_) * bitmap.height(), 0)
+    , emitters_(static_cast<size_t>(wordsPerRow_) * bitmap.height(), 0)
+    , blockRows_(static_cast<size_t>(blockWordsPerRow_) * blocksY_, 0)
+    , blockColumns_(static_cast<size_t>(blockWordsPerColumn_) * blocksX_, 0) {
+    for (int y = 0; y < height_; y++) {
+        for (int x = 0; x < width_; x++) {
+            const std::uint8_t cell = bitmap.cell(x, y);
+            if (!(cell & (WALL_MASK | EMITTER_MASK))) continue;
+
+            const std::uint64_t rowBit = std::uint64_t(1) << (x & 63);
+            const size_t rowWord = static_cast<size_t>(y) * wordsPerRow_ + (x >> 6);
+            if (cell & WALL_MASK) walls_[rowWord] |= rowBit;
+            if (cell & EMITTER_MASK) emitters_[rowWord] |= rowBit;
+
+            const int blockX = x >> BLOCK_SHIFT;
+            const int blockY = y >> BLOCK_SHIFT;
+            blockRows_[static_cast<size_t>(blockY) * blockWordsPerRow_ + (blockX >> 6)] |=
+                std::uint64_t(1) << (blockX & 63);
+            blockColumns_[static_cast<size_t>(blockX) * blockWordsPerColumn_ + (blockY >> 6)] |=
+                std::uint64_t(1) << (blockY & 63);
+        }
+    }
+}
+
+int PackedSceneBitmap::emptyBlockRunX(int blockX, int blockY, int step) const {
+    return emptyRun(&blockRows_[static_cast<size_t>(blockY) * blockWordsPerRow_], blocksX_, blockX,
+                    step);
+}
+
+int PackedSceneBitmap::emptyBlockRunY(int blockX, int blockY, int step) const {
+    return emptyRun(&blockColumns_[static_cast<size_t>(blockX) * blockWordsPerColumn_], blocksY_,
+                    blockY, step);
+}
@@ -0,0 +1,60 @@
+/*
+ * Bit-packed copy of a SceneBitmap for the CPU ray march.
+ *
+ * 64 cells per word, one plane for walls and one for emitters, row by row. On top of that there's
+ * a plane with one bit per BLOCK_SIZE x BLOCK_SIZE block of cells that is set if anything in the
+ * block is occupied, stored row by row and column by column. A ray in an empty block finds out how
+ * many empty blocks lie ahead of it with one word load and a count leading/trailing zeros.
+ */
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "SceneBitmap.hpp"
+
+class PackedSceneBitmap {
+public:
+    static constexpr int BLOCK_SHIFT = 3;
+    static constexpr int BLOCK_SIZE = 1 << BLOCK_SHIFT;
+
+    PackedSceneBitmap() = default;
+    explicit PackedSceneBitmap(const SceneBitmap& bitmap);
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+    bool empty() const { return walls_.empty(); }
+
+    bool wall(int x, int y) const { return bit(walls_, y * wordsPerRow_ + (x >> 6), x); }
+    bool emitter(int x, int y) const { return bit(emitters_, y * wordsPerRow_ + (x >> 6), x); }
+
+    int blocksX() const { return blocksX_; }
+    int blocksY() const { return blocksY_; }
+    bool blockEmpty(int blockX, int blockY) const {
+        return !bit(blockRows_, blockY * blockWordsPerRow_ + (blockX >> 6), blockX);
+    }
+
+    // Empty blocks in a row of blocks starting at (blockX, blockY) and walking in direction step
+    // (1 or -1), including the start. Stops at the first occupied block or the edge.
+    int emptyBlockRunX(int blockX, int blockY, int step) const;
+    // Same thing along a column of blocks.
+    int emptyBlockRunY(int blockX, int blockY, int step) const;
+
+private:
+    static bool bit(const std::vector<std::uint64_t>& plane, int word, int index) {
+        return (plane[static_cast<size_t>(word)] >> (index & 63)) & 1u;
+    }
+
+    int width_ = 0;
+    int height_ = 0;
+    int wordsPerRow_ = 0;
+    int blocksX_ = 0;
+    int blocksY_ = 0;
+    int blockWordsPerRow_ = 0;
+    int blockWordsPerColumn_ = 0;
+
+    std::vector<std::uint64_t> walls_;         //row-major
+    std::vector<std::uint64_t> emitters_;      //row-major
+    std::vector<std::uint64_t> blockRows_;     //occupied blocks, row-major
+    std::vector<std::uint64_t> blockColumns_;  //occupied blocks, column-major
+};
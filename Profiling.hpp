@@ -0,0 +1,54 @@
+/*
+ * Tracy instrumentation that compiles out. With TRACY_ENABLE (set by CMake when tracy/public
+ * exists and RC_TRACY is on) this includes Tracy; without it, the Tracy macros used in this repo
+ * expand to nothing, arguments included, so an uninstrumented build pays nothing for them.
+ * With RC_TRACY_ON_DEMAND, an instrumented build only collects while a Tracy server is connected.
+ *
+ * Use the Tracy macros as usual: ZoneScoped / ZoneScopedN for CPU zones, TracyGpuZone around GL
+ * work, TracyPlot, FrameMark, and TracyGpuContext / TracyGpuCollect once per context / frame.
+ * Names have to be string literals, Tracy keeps the pointers.
+ *
+ * For a zone per level, where the name isn't known at compile time: a table of ProfileSite made
+ * with PROFILE_SITE() and GpuZoneAt(table[i]) / ZoneAt(table[i]). No strings are built per call.
+ */
+#pragma once
+
+#ifdef TRACY_ENABLE
+
+#include <cstdint>
+
+#include <GL/glew.h>  //TracyOpenGL.hpp uses the query functions
+
+#include "Tracy.hpp"
+#include "TracyOpenGL.hpp"
+
+using ProfileSite = tracy::SourceLocationData;
+#define PROFILE_SITE(name, function) \
+    ProfileSite { name, function, __FILE__, static_cast<uint32_t>(__LINE__), 0 }
+
+#define RC_PROFILE_CONCAT_(a, b) a##b
+#define RC_PROFILE_CONCAT(a, b) RC_PROFILE_CONCAT_(a, b)
+#define ZoneAt(site) tracy::ScopedZone RC_PROFILE_CONCAT(rcZone, __LINE__)(&(site), true)
+#define GpuZoneAt(site) tracy::GpuCtxScope RC_PROFILE_CONCAT(rcGpuZone, __LINE__)(&(site), true)
+
+#else
+
+struct ProfileSite {
+    const char* name;
+};
+#define PROFILE_SITE(name, function) \
+    ProfileSite { name }
+
+#define ZoneAt(site) static_cast<void>(site)
+#define GpuZoneAt(site) static_cast<void>(site)
+
+#define ZoneScoped
+#define ZoneScopedN(name)
+#define FrameMark
+#define TracyPlot(name, value)
+#define TracyMessageL(text)
+#define TracyGpuContext
+#define TracyGpuZone(name)
+#define TracyGpuCollect
+
+#endif
@@ -0,0 +1,26 @@
+#include "SceneBitmap.hpp"
+
+#include "CascadeConstants.hpp"
+
+SceneBitmap::SceneBitmap(int width, int height)
+    : width_(width), height_(height), cells_(static_cast<size_t>(width) * height + CELL_PADDING, 0) {}
+
+SceneBitmap SceneBitmap::fromImage(const imageio::Image& image) {
+    SceneBitmap bitmap(image.width, image.height);
+
+    for (int y = 0; y < image.height; y++) {
+        for (int x = 0; x < image.width; x++) {
+            const std::uint8_t* texel =
+                &image.data[(static_cast<size_t>(y) * image.width + x) * image.channels];
+
+            //red = wall, green = emissive. > 127 is the same as > 0.5 on the normalized texel
+            std::uint8_t data = 0;
+            if (texel[0] > 127) data |= WALL_MASK;
+            if (texel[1] > 127) data |= EMITTER_MASK;
+            if (data != 0) data |= 0x4;  //material index 1 if its not empty for now.
+
+            bitmap.setCell(x, y, data);
+        }
+    }
+    return bitmap;
+}
@@ -0,0 +1,40 @@
+/*
+ * Host side version of the scene bitmap that GenerateSceneBitmap.comp writes into bitmapTex.
+ *
+ * Same layout as the GL_R8UI texture: 1 byte per cell, 2 least significant bits denote type
+ * (see WALL_MASK/EMITTER_MASK in CascadeConstants.hpp), the remaining 6 the material ID.
+ */
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "ImageIO.hpp"
+
+class SceneBitmap {
+public:
+    SceneBitmap() = default;
+    SceneBitmap(int width, int height);
+
+    // Same conversion as GenerateSceneBitmap.comp: red = wall, green = emitter.
+    static SceneBitmap fromImage(const imageio::Image& image);
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+    bool empty() const { return width_ == 0 || height_ == 0; }
+
+    std::uint8_t cell(int x, int y) const { return cells_[static_cast<size_t>(y) * width_ + x]; }
+    void setCell(int x, int y, std::uint8_t data) {
+        cells_[static_cast<size_t>(y) * width_ + x] = data;
+    }
+
+    const std::uint8_t* data() const { return cells_.data(); }
+
+    //extra bytes after the last cell, so 32 bit gathers of any cell stay inside the buffer
+    static constexpr int CELL_PADDING = 3;
+
+private:
+    int width_ = 0;
+    int height_ = 0;
+    std::vector<std::uint8_t> cells_;
+};
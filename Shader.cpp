@@ -7,7 +7,6 @@
  * This code is in the public domain.
  */
 #include <GL/glew.h>
-#include <GLFW/glfw3.h>
 
 #include "Shader.hpp"
 
@@ -44,22 +43,34 @@ std::string readFile(const std::string& filename) {
     in.seekg(0);  // reset file stream
 
     std::string buffer;
-    buffer.resize(fileLength + 1);
+    buffer.resize(fileLength);  // std::string keeps its own terminator, no '\0' in the contents
     in.read(buffer.data(), fileLength);
     if (in.bad()) {
         std::cerr << "Error: Could not read shader file '" << filename << "'\n";
         return {};
     }
 
-    buffer[fileLength] = '\0';  // make sure the string is null terminated
     in.close();
 
+    // Mesa refuses sources that start with a UTF-8 byte order mark
+    if (buffer.compare(0, 3, "\xEF\xBB\xBF") == 0) {
+        buffer.erase(0, 3);
+    }
+
     return buffer;
 }
 
-GLuint loadShader(GLenum shaderType, const std::string& filename) {
+GLuint loadShader(GLenum shaderType, const std::string& filename, const std::string& defines = "") {
     GLuint shader = glCreateShader(shaderType);
     std::string shaderSource = readFile(filename);
+    if (!defines.empty()) {
+        // nothing but comments may come before #version
+        const size_t version = shaderSource.find("#version");
+        const size_t lineEnd = version == std::string::npos ? version : shaderSource.find('\n', version);
+        if (lineEnd != std::string::npos) {
+            shaderSource.insert(lineEnd + 1, defines);
+        }
+    }
     if (!shaderSource.empty()) {
         const char* source = shaderSource.c_str();
         glShaderSource(shader, 1, &source, nullptr);
@@ -80,7 +91,8 @@ GLuint loadShader(GLenum shaderType, const std::string& filename) {
 }
 
 void Shader::createShader(const std::string& vertexshaderfile,
-                          const std::string& fragmentshaderfile) {
+                          const std::string& fragmentshaderfile,
+                          const std::string& fragmentDefines) {
     // If a program is already stored in this object, delete it
     if (programID_ != 0) {
         glDeleteProgram(programID_);
@@ -88,7 +100,7 @@ void Shader::createShader(const std::string& vertexshaderfile,
 
     // Create the vertex shader.
     GLuint vertexShader = loadShader(GL_VERTEX_SHADER, vertexshaderfile);
-    GLuint fragmentShader = loadShader(GL_FRAGMENT_SHADER, fragmentshaderfile);
+    GLuint fragmentShader = loadShader(GL_FRAGMENT_SHADER, fragmentshaderfile, fragmentDefines);
 
     // Create a program object and attach the two compiled shaders.
     GLuint programObject = glCreateProgram();
@@ -113,11 +125,11 @@ void Shader::createShader(const std::string& vertexshaderfile,
 }
 
 //should probably just have made the above function variadic, but sometimes it's just easier to write it twice.
-void Shader::createComputeShader(const std::string& computeshaderfile) {
+void Shader::createComputeShader(const std::string& computeshaderfile, const std::string& defines) {
     if (programID_ != 0) {
         glDeleteProgram(programID_);
     }
-    GLuint computeShader = loadShader(GL_COMPUTE_SHADER, computeshaderfile);
+    GLuint computeShader = loadShader(GL_COMPUTE_SHADER, computeshaderfile, defines);
     
     GLuint programObject = glCreateProgram();
     glAttachShader(programObject, computeShader);
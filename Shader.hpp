@@ -12,7 +12,7 @@
  */
 #pragma once
 
-#include <GLFW/glfw3.h>
+#include <GL/glew.h>
 #include <string>
 
 class Shader {
@@ -29,11 +29,17 @@ public:
     ~Shader();
 
     // createShader() - create, load, compile and link the GLSL shader objects.
-    void createShader(const std::string& vertexshaderfile, const std::string& fragmentshaderfile);
-    void createComputeShader(const std::string& computeshaderfile);
+    // fragmentDefines go in the fragment shader like the defines of createComputeShader().
+    void createShader(const std::string& vertexshaderfile, const std::string& fragmentshaderfile,
+                      const std::string& fragmentDefines = "");
+    // defines, e.g. "#define LOCAL_SIZE_X 8\n", go in right after the #version line
+    void createComputeShader(const std::string& computeshaderfile, const std::string& defines = "");
 
     GLuint id() const;
 
 private:
     GLuint programID_;
 };
+
+// The contents of a shader file, empty if it can't be read. For code shared through the defines.
+std::string readFile(const std::string& filename);
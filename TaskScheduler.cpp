@@ -0,0 +1,123 @@
+#include "TaskScheduler.hpp"
+
+#include <algorithm>
+
+TaskScheduler::TaskScheduler(unsigned threadCount) {
+    if (threadCount == 0) threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+    for (unsigned i = 0; i < threadCount; i++) queues_.push_back(std::make_unique<Queue>());
+    stealCounts_.assign(threadCount, 0);
+
+    workers_.reserve(threadCount - 1);
+    for (unsigned i = 1; i < threadCount; i++) {
+        workers_.emplace_back(&TaskScheduler::workerLoop, this, i);
+    }
+}
+
+TaskScheduler::~TaskScheduler() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        quit_ = true;
+    }
+    wake_.notify_all();
+    for (std::thread& worker : workers_) worker.join();
+}
+
+unsigned TaskScheduler::size() const { return static_cast<unsigned>(queues_.size()); }
+
+void TaskScheduler::run(int taskCount, const std::function<void(int)>& task) {
+    if (taskCount <= 0) return;
+
+    std::fill(stealCounts_.begin(), stealCounts_.end(), 0);
+
+    //not worth waking anyone up
+    if (workers_.empty() || taskCount == 1) {
+        for (int i = 0; i < taskCount; i++) task(i);
+        return;
+    }
+
+    //deal round robin, so every queue starts with its share of the heavy tasks
+    const unsigned threads = size();
+    for (unsigned q = 0; q < threads; q++) {
+        std::lock_guard<std::mutex> lock(queues_[q]->mutex);
+        queues_[q]->tasks.clear();
+        for (int i = static_cast<int>(q); i < taskCount; i += static_cast<int>(threads)) {
+            queues_[q]->tasks.push_back(i);
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        task_ = &task;
+        busy_ = static_cast<unsigned>(workers_.size());
+        generation_++;
+    }
+    wake_.notify_all();
+
+    work(0);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this] { return busy_ == 0; });
+    task_ = nullptr;
+}
+
+void TaskScheduler::parallelFor(int begin, int end, int chunk,
+                                const std::function<void(int)>& body) {
+    if (begin >= end) return;
+    chunk = std::max(1, chunk);
+
+    const int taskCount = (end - begin + chunk - 1) / chunk;
+    run(taskCount, [&](int task) {
+        const int first = begin + task * chunk;
+        const int last = std::min(first + chunk, end);
+        for (int i = first; i < last; i++) body(i);
+    });
+}
+
+void TaskScheduler::workerLoop(unsigned index) {
+    unsigned seenGeneration = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [&] { return quit_ || generation_ != seenGeneration; });
+            if (quit_) return;
+            seenGeneration = generation_;
+        }
+
+        work(index);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (--busy_ == 0) done_.notify_one();
+    }
+}
+
+void TaskScheduler::work(unsigned index) {
+    //tasks are never added during a run, so once every queue is empty we're done
+    int task;
+    while (popOwn(index, task) || steal(index, task)) {
+        (*task_)(task);
+    }
+}
+
+bool TaskScheduler::popOwn(unsigned index, int& task) {
+    Queue& queue = *queues_[index];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty()) return false;
+    task = queue.tasks.front();
+    queue.tasks.pop_front();
+    return true;
+}
+
+bool TaskScheduler::steal(unsigned index, int& task) {
+    const unsigned threads = size();
+    for (unsigned offset = 1; offset < threads; offset++) {
+        Queue& victim = *queues_[(index + offset) % threads];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (victim.tasks.empty()) continue;
+        task = victim.tasks.back();
+        victim.tasks.pop_back();
+        stealCounts_[index]++;
+        return true;
+    }
+    return false;
+}
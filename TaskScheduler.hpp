@@ -0,0 +1,66 @@
+/*
+ * Work-stealing task scheduler for the CPU cascade path.
+ *
+ * Usage: create one scheduler and keep it alive, then call run() or parallelFor() for every pass.
+ * The calling thread takes part in the work, so a scheduler of size N spawns N - 1 threads.
+ *
+ * run() deals the tasks round robin onto one queue per thread, in the order they're numbered.
+ * Threads work through their own queue from the front, and when it runs dry they steal from the
+ * back of the others. Number the tasks heaviest first and the long ones get started early while
+ * the short ones fill the gaps at the end.
+ */
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class TaskScheduler {
+public:
+    // threadCount = 0 uses std::thread::hardware_concurrency()
+    explicit TaskScheduler(unsigned threadCount = 0);
+    ~TaskScheduler();
+
+    TaskScheduler(const TaskScheduler&) = delete;
+    TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+    // amount of threads working on a run(), including the caller
+    unsigned size() const;
+
+    // Calls task(i) for every i in [0, taskCount). Blocks until every task is done.
+    void run(int taskCount, const std::function<void(int)>& task);
+
+    // Calls body(i) for every i in [begin, end), chunk indices per task.
+    void parallelFor(int begin, int end, int chunk, const std::function<void(int)>& body);
+
+    // tasks each thread stole during the last run(), for checking the balance
+    const std::vector<int>& stealCounts() const { return stealCounts_; }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<int> tasks;
+    };
+
+    void workerLoop(unsigned index);
+    void work(unsigned index);
+    bool popOwn(unsigned index, int& task);
+    bool steal(unsigned index, int& task);
+
+    std::vector<std::thread> workers_;
+    std::vector<std::unique_ptr<Queue>> queues_;  //one per thread, index 0 is the caller
+    std::vector<int> stealCounts_;
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    unsigned generation_ = 0;  //bumped for every run so sleeping workers know there's work
+    unsigned busy_ = 0;        //workers that haven't finished the current generation
+    bool quit_ = false;
+
+    const std::function<void(int)>* task_ = nullptr;
+};
@@ -14,7 +14,7 @@
  */
 #pragma once
 
-#include <GLFW/glfw3.h>
+#include <GL/glew.h>
 #include <string>
 #include <vector>
 
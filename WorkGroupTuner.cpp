@@ -0,0 +1,123 @@
+#include "WorkGroupTuner.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <utility>
+
+namespace {
+
+//local sizes to try. the first is the default of the tuned shaders and what tune() falls back to
+constexpr WorkGroupSize CANDIDATES[] = {
+    {16, 16}, {8, 8}, {16, 8}, {8, 16}, {32, 8}, {8, 32}, {32, 16}, {16, 32}, {64, 4}, {32, 32},
+};
+
+std::string glString(GLenum name) {
+    const GLubyte* value = glGetString(name);
+    return value ? reinterpret_cast<const char*>(value) : "unknown";
+}
+
+}  // namespace
+
+WorkGroupTuner::WorkGroupTuner(std::string cacheFile) : cacheFile_(std::move(cacheFile)) {
+    //tabs separate the fields of the cache
+    renderer_ = glString(GL_VENDOR) + " | " + glString(GL_RENDERER) + " | " + glString(GL_VERSION);
+    std::replace(renderer_.begin(), renderer_.end(), '\t', ' ');
+    glGenQueries(2, queries_);
+
+    std::ifstream in(cacheFile_);
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream fields(line);
+        std::string renderer, kernel;
+        WorkGroupSize size;
+        if (!std::getline(fields, renderer, '\t') || !std::getline(fields, kernel, '\t') ||
+            !(fields >> size.x >> size.y)) {
+            continue;  //not a cache line, dropped on save
+        }
+        if (renderer == renderer_) {
+            sizes_[kernel] = size;
+        } else {
+            otherLines_.push_back(line);
+        }
+    }
+}
+
+WorkGroupTuner::~WorkGroupTuner() { glDeleteQueries(2, queries_); }
+
+bool WorkGroupTuner::cached(const std::string& kernel, WorkGroupSize& size) const {
+    const auto it = sizes_.find(kernel);
+    if (it == sizes_.end()) return false;
+    size = it->second;
+    return true;
+}
+
+std::vector<WorkGroupSize> WorkGroupTuner::candidates(int width, int height) {
+    GLint maxInvocations = 0;
+    GLint maxSize[2] = {};
+    glGetIntegerv(GL_MAX_COMPUTE_WORK_GROUP_INVOCATIONS, &maxInvocations);
+    glGetIntegeri_v(GL_MAX_COMPUTE_WORK_GROUP_SIZE, 0, &maxSize[0]);
+    glGetIntegeri_v(GL_MAX_COMPUTE_WORK_GROUP_SIZE, 1, &maxSize[1]);
+
+    std::vector<WorkGroupSize> fitting;
+    for (const WorkGroupSize& size : CANDIDATES) {
+        if (size.x * size.y <= maxInvocations && size.x <= maxSize[0] && size.y <= maxSize[1] &&
+            width % size.x == 0 && height % size.y == 0) {
+            fitting.push_back(size);
+        }
+    }
+    return fitting;
+}
+
+WorkGroupSize WorkGroupTuner::tune(const std::string& kernel,
+                                   const std::vector<WorkGroupSize>& candidates,
+                                   const std::function<void(WorkGroupSize)>& prepare,
+                                   const std::function<void()>& run) {
+    WorkGroupSize best = CANDIDATES[0];
+    double bestMs = -1;
+    for (const WorkGroupSize& size : candidates) {
+        prepare(size);
+        timeRun(run);  //warm up, the first dispatch of a program pays for the driver's setup
+        double runs[RUNS];
+        for (double& ms : runs) ms = timeRun(run);
+        std::sort(runs, runs + RUNS);
+        const double ms = runs[RUNS / 2];
+        if (bestMs < 0 || ms < bestMs) {
+            best = size;
+            bestMs = ms;
+        }
+    }
+    std::cout << "Work group size of " << kernel << ": " << best.x << "x" << best.y << " ("
+              << bestMs << " ms)\n";
+    sizes_[kernel] = best;
+    return best;
+}
+
+void WorkGroupTuner::save() const {
+    std::ofstream out(cacheFile_);
+    if (!out.is_open()) {
+        std::cerr << "ERROR: Couldn't write the work group cache: " << cacheFile_ << "\n";
+        return;
+    }
+    for (const std::string& line : otherLines_) out << line << "\n";
+    for (const auto& [kernel, size] : sizes_) {
+        out << renderer_ << "\t" << kernel << "\t" << size.x << "\t" << size.y << "\n";
+    }
+}
+
+std::string WorkGroupTuner::defines(WorkGroupSize size) {
+    return "#define LOCAL_SIZE_X " + std::to_string(size.x) + "\n#define LOCAL_SIZE_Y " +
+           std::to_string(size.y) + "\n";
+}
+
+double WorkGroupTuner::timeRun(const std::function<void()>& run) {
+    //timestamps rather than GL_TIME_ELAPSED, which llvmpipe doesn't report sensibly
+    glQueryCounter(queries_[0], GL_TIMESTAMP);
+    run();
+    glQueryCounter(queries_[1], GL_TIMESTAMP);
+    GLuint64 begin = 0, end = 0;
+    glGetQueryObjectui64v(queries_[0], GL_QUERY_RESULT, &begin);
+    glGetQueryObjectui64v(queries_[1], GL_QUERY_RESULT, &end);
+    return static_cast<double>(end - begin) / 1e6;
+}
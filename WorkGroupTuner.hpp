@@ -0,0 +1,68 @@
+/*
+ * Picks the local size of a compute shader by timing it: every candidate that fits the driver's
+ * limits and divides the grid gets compiled and dispatched, and the fastest one wins. The
+ * dispatch shape follows from the local size, grid / local size groups per axis.
+ *
+ * The choices are cached per renderer (GL_VENDOR, GL_RENDERER and GL_VERSION) in a text file,
+ * one "renderer<TAB>kernel<TAB>x<TAB>y" line each, so later runs on the same driver reuse them.
+ *
+ * Usage: create it with a current GL context. cached() returns the size stored for a kernel,
+ * tune() times the candidates and stores the best, save() writes the cache back. Shaders take the
+ * size as #define LOCAL_SIZE_X / LOCAL_SIZE_Y, see defines().
+ */
+#pragma once
+
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+
+struct WorkGroupSize {
+    int x;
+    int y;
+};
+
+class WorkGroupTuner {
+public:
+    // next to the generated shaders, like them it's made by the program
+    static constexpr const char* CACHE_FILE = "shaders/generated/WorkGroups.cache";
+    static constexpr int RUNS = 3;  //timed dispatches per candidate, after one warm up
+
+    explicit WorkGroupTuner(std::string cacheFile = CACHE_FILE);
+    ~WorkGroupTuner();
+
+    WorkGroupTuner(const WorkGroupTuner&) = delete;
+    WorkGroupTuner& operator=(const WorkGroupTuner&) = delete;
+
+    const std::string& renderer() const { return renderer_; }
+
+    // The size stored for kernel on this renderer, false if there is none.
+    bool cached(const std::string& kernel, WorkGroupSize& size) const;
+
+    // Local sizes that divide a width x height grid and that the driver supports.
+    static std::vector<WorkGroupSize> candidates(int width, int height);
+
+    // Times every candidate: prepare(size) builds the program, run() dispatches it. Returns the
+    // one with the lowest median GPU time and stores it for kernel. Leaves the last candidate
+    // prepared, not the best one.
+    WorkGroupSize tune(const std::string& kernel, const std::vector<WorkGroupSize>& candidates,
+                       const std::function<void(WorkGroupSize)>& prepare,
+                       const std::function<void()>& run);
+
+    // Writes the cache, keeping the entries of other renderers.
+    void save() const;
+
+    // "#define LOCAL_SIZE_X x\n#define LOCAL_SIZE_Y y\n", for Shader::createComputeShader()
+    static std::string defines(WorkGroupSize size);
+
+private:
+    double timeRun(const std::function<void()>& run);  //GPU milliseconds of one run()
+
+    std::string cacheFile_;
+    std::string renderer_;
+    std::map<std::string, WorkGroupSize> sizes_;  //of this renderer, by kernel
+    std::vector<std::string> otherLines_;         //of the other renderers, kept as they are
+    GLuint queries_[2] = {};
+};
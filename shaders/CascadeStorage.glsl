@@ -0,0 +1,240 @@
+//how a texel of the cascade array is stored, put in front of Cascade.comp, MergeCascades.comp, FusedMerge.comp and
+//ScreenWrite.frag by GpuCascades.cpp, after one of these (see GpuCascades::StorageFormat):
+//  CASCADE_RGBA16F         - rgb = radiance, a = gotBlocked. 8 bytes per ray
+//  CASCADE_R11F_G11F_B10F  - radiance, gotBlocked is a bit of _BlockedBits. 4 bytes + 1 bit per ray
+//  CASCADE_RGB9E5          - radiance as r32ui with a shared exponent, gotBlocked in _BlockedBits. 4 bytes + 1 bit
+//  CASCADE_PACKED32        - r32ui: 3 x 10 bit floats (5 bit exponent, 5 bit mantissa) + gotBlocked in bit 31. 4 bytes
+//every format but RGBA16F drops negative radiance, the rays never gather any.
+//
+//LoadCascade() reads through the sampler, LoadCascadeImage() through the image: rgb = radiance, a = gotBlocked (0 / 1).
+//StoreCascade() writes both, StoreRadiance() only the radiance and keeps the flag if it's stored apart.
+//the image is coherent if CASCADE_COHERENT is defined as coherent, for FusedMerge.comp.
+//LoadDirectionBlock() / StoreDirectionBlock() read and write the direction blocks, see below.
+//with CASCADE_PING_PONG the array only has two layers, even levels go to layer 0 and odd ones to layer 1. texel.z is
+//always the level, StorageTexel() picks the layer.
+//with CASCADE_DIRECTION_MAJOR a layer holds an image of every probe per direction instead of a block of every direction
+//per probe, so the same direction of neighbouring probes is in neighbouring texels. texel.xy is still probe major,
+//StorageTexel() moves it. the float formats then also get LoadRadianceFiltered(), see below.
+//CASCADE_PROBE_SCALE spaces the probes of every level 1, 2 or 4 times as far apart, see GpuCascades::setProbeScale().
+//every level then has 1 / CASCADE_PROBE_SCALE^2 of the probes and rays, in layers CASCADE_STORAGE_SIDE wide.
+
+#ifndef CASCADE_COHERENT
+#define CASCADE_COHERENT
+#endif
+
+#ifndef CASCADE_PROBE_SCALE
+#define CASCADE_PROBE_SCALE 1
+#endif
+
+const int CASCADE_STORAGE_SIDE = 1024 / CASCADE_PROBE_SCALE;
+const int STORAGE_PROBE_SIDES[7] = { 2, 4, 8, 16, 32, 64, 128};
+
+int StorageLayer(int level) {
+#ifdef CASCADE_PING_PONG
+    return level & 1;
+#else
+    return level;
+#endif
+}
+
+//probe major texel of a level -> direction major texel, and back
+ivec2 DirectionMajorTexel(ivec2 texel, int level) {
+    int side = STORAGE_PROBE_SIDES[level];
+    return (texel % side) * (CASCADE_STORAGE_SIDE / side) + texel / side;
+}
+
+ivec2 ProbeMajorTexel(ivec2 texel, int level) {
+    int gridSide = CASCADE_STORAGE_SIDE / STORAGE_PROBE_SIDES[level];
+    return (texel % gridSide) * STORAGE_PROBE_SIDES[level] + texel / gridSide;
+}
+
+ivec3 StorageTexel(ivec3 texel) {
+#ifdef CASCADE_DIRECTION_MAJOR
+    return ivec3(DirectionMajorTexel(texel.xy, texel.z), StorageLayer(texel.z));
+#else
+    return ivec3(texel.xy, StorageLayer(texel.z));
+#endif
+}
+
+#if defined(CASCADE_RGB9E5) || defined(CASCADE_PACKED32)
+layout(binding = 2) uniform usampler2DArray _cascadeSampler;
+layout(binding = 2, r32ui) uniform CASCADE_COHERENT uimage2DArray _cascadeImage;
+#elif defined(CASCADE_R11F_G11F_B10F)
+layout(binding = 2) uniform sampler2DArray _cascadeSampler;
+layout(binding = 2, r11f_g11f_b10f) uniform CASCADE_COHERENT image2DArray _cascadeImage;
+#else
+layout(binding = 2) uniform sampler2DArray _cascadeSampler;
+layout(binding = 2, rgba16f) uniform CASCADE_COHERENT image2DArray _cascadeImage;
+#endif
+
+#if defined(CASCADE_R11F_G11F_B10F) || defined(CASCADE_RGB9E5)
+#define CASCADE_BLOCKED_BITS
+//gotBlocked of every texel, bit (index & 31) of _BlockedBits[index >> 5], index = (layer * side + y) * side + x
+layout(std430, binding = 7) buffer BlockedBits { uint _BlockedBits[]; };
+
+int BlockedIndex(ivec3 texel) {
+    texel = StorageTexel(texel);
+    return (texel.z * CASCADE_STORAGE_SIDE + texel.y) * CASCADE_STORAGE_SIDE + texel.x;
+}
+
+float LoadBlocked(ivec3 texel) {
+    int index = BlockedIndex(texel);
+    return float((_BlockedBits[index >> 5] >> uint(index & 31)) & 1u);
+}
+
+//neighbouring texels share the word, so atomics
+void StoreBlocked(ivec3 texel, float gotBlocked) {
+    int index = BlockedIndex(texel);
+    uint bit = 1u << uint(index & 31);
+    if (gotBlocked > 0)
+        atomicOr(_BlockedBits[index >> 5], bit);
+    else
+        atomicAnd(_BlockedBits[index >> 5], ~bit);
+}
+#endif
+
+#ifdef CASCADE_RGB9E5
+//the GL_RGB9_E5 encoding of the GL spec: 9 bit mantissas sharing a 5 bit exponent, bias 15
+uint PackRgb9e5(vec3 radiance) {
+    const float MAX_RGB9E5 = 65408.0;  //(511 / 512) * 2^16
+    vec3 c = clamp(radiance, 0.0, MAX_RGB9E5);
+    float maxComponent = max(c.r, max(c.g, c.b));
+    if (maxComponent == 0.0)
+        return 0u;
+    int exponent = max(-16, int(floor(log2(maxComponent)))) + 16;
+    float scale = exp2(float(exponent - 24));
+    if (floor(maxComponent / scale + 0.5) >= 512.0) {  //rounded up into the next exponent
+        exponent++;
+        scale *= 2.0;
+    }
+    uvec3 m = uvec3(floor(c / scale + 0.5));
+    return m.r | (m.g << 9) | (m.b << 18) | (uint(exponent) << 27);
+}
+
+vec3 UnpackRgb9e5(uint word) {
+    float scale = exp2(float(int(word >> 27) - 24));
+    return vec3(word & 511u, (word >> 9) & 511u, (word >> 18) & 511u) * scale;
+}
+#endif
+
+#ifdef CASCADE_PACKED32
+//the top 10 bits of a half below its sign bit, rounded to nearest
+uint PackFloat10(float value) {
+    const float MAX_FLOAT10 = 64512.0;  //largest finite half with a 5 bit mantissa
+    uint halfBits = packHalf2x16(vec2(clamp(value, 0.0, MAX_FLOAT10), 0.0)) & 0x7FFFu;
+    return (halfBits + 16u) >> 5;
+}
+
+uint PackPacked32(vec3 radiance, float gotBlocked) {
+    return PackFloat10(radiance.r) | (PackFloat10(radiance.g) << 10) | (PackFloat10(radiance.b) << 20) |
+           (gotBlocked > 0 ? 0x80000000u : 0u);
+}
+
+vec4 UnpackPacked32(uint word) {
+    vec2 rg = unpackHalf2x16(((word & 0x3FFu) << 5) | (((word >> 10) & 0x3FFu) << 21));
+    float b = unpackHalf2x16(((word >> 20) & 0x3FFu) << 5).x;
+    return vec4(rg, b, float(word >> 31));
+}
+#endif
+
+vec4 LoadCascade(ivec3 texel) {
+    ivec3 layerTexel = StorageTexel(texel);
+#if defined(CASCADE_RGB9E5)
+    return vec4(UnpackRgb9e5(texelFetch(_cascadeSampler, layerTexel, 0).r), LoadBlocked(texel));
+#elif defined(CASCADE_PACKED32)
+    return UnpackPacked32(texelFetch(_cascadeSampler, layerTexel, 0).r);
+#elif defined(CASCADE_R11F_G11F_B10F)
+    return vec4(texelFetch(_cascadeSampler, layerTexel, 0).rgb, LoadBlocked(texel));
+#else
+    return texelFetch(_cascadeSampler, layerTexel, 0);
+#endif
+}
+
+//only the radiance, for sums over many texels
+vec3 LoadRadiance(ivec3 texel) {
+    ivec3 layerTexel = StorageTexel(texel);
+#if defined(CASCADE_RGB9E5)
+    return UnpackRgb9e5(texelFetch(_cascadeSampler, layerTexel, 0).r);
+#elif defined(CASCADE_PACKED32)
+    return UnpackPacked32(texelFetch(_cascadeSampler, layerTexel, 0).r).rgb;
+#else
+    return texelFetch(_cascadeSampler, layerTexel, 0).rgb;
+#endif
+}
+
+vec4 LoadCascadeImage(ivec3 texel) {
+    ivec3 layerTexel = StorageTexel(texel);
+#if defined(CASCADE_RGB9E5)
+    return vec4(UnpackRgb9e5(imageLoad(_cascadeImage, layerTexel).r), LoadBlocked(texel));
+#elif defined(CASCADE_PACKED32)
+    return UnpackPacked32(imageLoad(_cascadeImage, layerTexel).r);
+#elif defined(CASCADE_R11F_G11F_B10F)
+    return vec4(imageLoad(_cascadeImage, layerTexel).rgb, LoadBlocked(texel));
+#else
+    return imageLoad(_cascadeImage, layerTexel);
+#endif
+}
+
+vec3 LoadRadianceImage(ivec3 texel) {
+    ivec3 layerTexel = StorageTexel(texel);
+#if defined(CASCADE_RGB9E5)
+    return UnpackRgb9e5(imageLoad(_cascadeImage, layerTexel).r);
+#elif defined(CASCADE_PACKED32)
+    return UnpackPacked32(imageLoad(_cascadeImage, layerTexel).r).rgb;
+#else
+    return imageLoad(_cascadeImage, layerTexel).rgb;
+#endif
+}
+
+//gotBlocked is only needed by PACKED32 and RGBA16F, which keep it in the same texel
+void StoreRadiance(ivec3 texel, vec3 radiance, float gotBlocked) {
+    ivec3 layerTexel = StorageTexel(texel);
+#if defined(CASCADE_RGB9E5)
+    imageStore(_cascadeImage, layerTexel, uvec4(PackRgb9e5(radiance)));
+#elif defined(CASCADE_PACKED32)
+    imageStore(_cascadeImage, layerTexel, uvec4(PackPacked32(radiance, gotBlocked)));
+#elif defined(CASCADE_R11F_G11F_B10F)
+    imageStore(_cascadeImage, layerTexel, vec4(radiance, 1.0));
+#else
+    imageStore(_cascadeImage, layerTexel, vec4(radiance, gotBlocked));
+#endif
+}
+
+void StoreCascade(ivec3 texel, vec4 ray) {
+    StoreRadiance(texel, ray.rgb, ray.a);
+#ifdef CASCADE_BLOCKED_BITS
+    StoreBlocked(texel, ray.a);
+#endif
+}
+
+#if defined(CASCADE_DIRECTION_MAJOR) && !defined(CASCADE_RGB9E5) && !defined(CASCADE_PACKED32)
+#define CASCADE_FILTERED
+//the cascades again with linear filtering, bound with a sampler object by GpuCascades::createCascadeStorage()
+layout(binding = 5) uniform sampler2DArray _cascadeFiltered;
+
+//direction of the probes probe .. probe + (1, 1) of level, bilinearly interpolated at fraction from probe.
+//one fetch instead of 4, all 4 probes have to be in the grid
+vec3 LoadRadianceFiltered(ivec2 probe, ivec2 direction, int level, vec2 fraction) {
+    int gridSide = CASCADE_STORAGE_SIDE / STORAGE_PROBE_SIDES[level];
+    vec2 uv = (vec2(direction * gridSide + probe) + fraction + 0.5) / float(CASCADE_STORAGE_SIDE);
+    return textureLod(_cascadeFiltered, vec3(uv, StorageLayer(level)), 0.0).rgb;
+}
+#endif
+
+//direction blocks: the mean radiance of every CASCADE_SCALING neighbouring texels of a row, the directions that merge into
+//one direction of the level below. a quarter as wide as the cascades, rgba16f in every format. the merges write them for
+//the layer they merge into and read them for the layer they merge from, one fetch instead of CASCADE_SCALING.
+//bound by GpuCascades::bindDirectionBlocks() before a merge uses them. always probe major, not used with
+//CASCADE_DIRECTION_MAJOR
+const int DIRECTION_BLOCK_SIZE = 4;  //CASCADE_SCALING
+layout(binding = 3, rgba16f) uniform CASCADE_COHERENT image2DArray _directionBlocks;
+
+//texel is the first texel of the block
+vec3 LoadDirectionBlock(ivec3 texel) {
+    return imageLoad(_directionBlocks, ivec3(texel.x / DIRECTION_BLOCK_SIZE, texel.y, StorageLayer(texel.z))).rgb;
+}
+
+void StoreDirectionBlock(ivec3 texel, vec3 mean) {
+    ivec3 block = ivec3(texel.x / DIRECTION_BLOCK_SIZE, texel.y, StorageLayer(texel.z));
+    imageStore(_directionBlocks, block, vec4(mean, 1.0));
+}
@@ -3,14 +3,17 @@
 in vec2 texCoords;
 out vec4 fragColor;
 
-layout(binding = 2) uniform sampler2DArray _Texture;
+//cascades: read with LoadRadiance(), see CascadeStorage.glsl
+layout(binding = 4) uniform sampler2D _fluence;    //mip N = probes of layer N, see ReduceFluence.comp
+layout(binding = 7) uniform sampler2D _upsampled;  //a texel per cell, see BiCubicInterpolation.comp
 
-const int PROBE_TEXTURE_SIDE = 1024;
+const int PROBE_TEXTURE_SIDE = CASCADE_STORAGE_SIDE;
 const int PROBE_BLOCK_SIDES[7] = { 2, 4, 8, 16, 32, 64, 128};
 
 uniform int _Layer;
 
 uniform int _Interpolate;
+uniform int _Upsample;    //the probes of _Layer reconstructed per cell instead of interpolated here
 uniform int _ProbeUV;
 
 //the 4 possible weights when doing bilinear merging in a grid
@@ -19,51 +22,50 @@ vec4[2](vec4(0.5625, 0.1875, 0.1875, 0.0625), vec4(0.1875, 0.5625, 0.0625, 0.187
 vec4[2](vec4(0.1875, 0.0625, 0.5625, 0.1875), vec4(0.0625, 0.1875, 0.1875, 0.5625))
 );
 
-//used to sample probes of higher cascades, or if we increase ray count in cascade 0 (VERY SLOW AT HIGHER CASCADES)
+//the average light of a probe, from the fluence texture. GpuCascades::buildFluence() reduces each probe of a layer to a
+//texel of mip _Layer. probes outside the grid are dark
 vec3 SampleProbe(ivec2 probe) {
-    ivec2 baseProbeTexel = probe * PROBE_BLOCK_SIDES[_Layer];
-    
-    vec3 light = vec3(0f);
-    for(int x = 0; x < PROBE_BLOCK_SIDES[_Layer]; x++)
-        for(int y = 0; y < PROBE_BLOCK_SIDES[_Layer]; y++)
-            light += texelFetch(_Texture, ivec3(baseProbeTexel + ivec2(x, y), _Layer), 0).rgb;
-
-    float avg = 1f / (PROBE_BLOCK_SIDES[_Layer] * PROBE_BLOCK_SIDES[_Layer]);
-    return avg * light;
+    ivec2 gridExtent = textureSize(_fluence, _Layer);
+    if (any(lessThan(probe, ivec2(0))) || any(greaterThanEqual(probe, gridExtent)))
+        return vec3(0.0f);
+    return texelFetch(_fluence, probe, _Layer).rgb;
 }
 
-
 void main() {
     
-    vec2 sourceProbeCoord = (texCoords * PROBE_TEXTURE_SIDE) / PROBE_BLOCK_SIDES[_Layer];     //which source probe the target probe belongs to
-    ivec2 base = ivec2(floor(sourceProbeCoord));
+    vec3 lighting;
+    if(_Upsample == 1){
+        lighting = texture(_upsampled, texCoords).rgb;
+    } else {
+        vec2 sourceProbeCoord = (texCoords * PROBE_TEXTURE_SIDE) / PROBE_BLOCK_SIDES[_Layer];     //which source probe the target probe belongs to
+        ivec2 base = ivec2(floor(sourceProbeCoord));
     
-    //shift the source probe coords to be the 4 source probes which centers are the closest to the center of the target probe.
-    //imagine a single source probe that contains a 2x2 block of target probes. we select our 4 source probes in the direction of the target probe from the sources center.
-    ivec2 offset = ivec2(1,1) - ivec2(floor((sourceProbeCoord - base) * 2)); //TL:1,1   BR:0,0
-    base.x -= offset.x;
-    base.y -= offset.y;
+        //shift the source probe coords to be the 4 source probes which centers are the closest to the center of the target probe.
+        //imagine a single source probe that contains a 2x2 block of target probes. we select our 4 source probes in the direction of the target probe from the sources center.
+        ivec2 offset = ivec2(1,1) - ivec2(floor((sourceProbeCoord - base) * 2)); //TL:1,1   BR:0,0
+        base.x -= offset.x;
+        base.y -= offset.y;
     
-    vec4 weight = weights[offset.y][offset.x];
+        vec4 weight = weights[offset.y][offset.x];
     
-    vec3 P00 = SampleProbe(base);
-    vec3 P10 = SampleProbe(base + ivec2(1, 0));
-    vec3 P01 = SampleProbe(base + ivec2(0, 1));
-    vec3 P11 = SampleProbe(base + ivec2(1, 1));
-    
-    vec3 lighting = 
-    P00 * weight.x +
-    P10 * weight.y +
-    P01 * weight.z +
-    P11 * weight.w;
+        vec3 P00 = SampleProbe(base);
+        vec3 P10 = SampleProbe(base + ivec2(1, 0));
+        vec3 P01 = SampleProbe(base + ivec2(0, 1));
+        vec3 P11 = SampleProbe(base + ivec2(1, 1));
     
+        lighting = 
+        P00 * weight.x +
+        P10 * weight.y +
+        P01 * weight.z +
+        P11 * weight.w;
+    }
     
     lighting.r = pow(lighting.r, 1/2.2f);   //gamma correction
     lighting.g = pow(lighting.g, 1/2.2f);
     lighting.b = pow(lighting.b, 1/2.2f);
     
     if(_Interpolate == 0){
-        lighting = texture(_Texture, vec3(texCoords, _Layer)).rgb * 10;
+        lighting = LoadRadiance(ivec3(ivec2(texCoords * PROBE_TEXTURE_SIDE), _Layer)) * 10; //the texel under texCoords, like a nearest filtered texture()
     }
     
     if(_ProbeUV == 1){